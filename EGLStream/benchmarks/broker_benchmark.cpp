@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "EGLStream/stream_broker.h"
+
+// Aggregate throughput and CPU cost of N broker channels, each with one
+// producer and one consumer thread passing synthetic frames through the
+// channel's shared ring. Producers run at a camera-like frame rate and
+// consumers block in waitRead() while the ring is empty, so the CPU columns
+// are copies, wakeups and accounting of every frame rather than polling.
+//
+// Usage: broker_benchmark [seconds per step] [frame bytes] [fps per channel]
+
+namespace {
+
+const std::string SOCKET_PATH = "/tmp/egl-broker-benchmark.sock";
+constexpr size_t SLOT_COUNT = 4;
+// Bounds how long a consumer takes to notice the end of a step.
+constexpr auto STOP_CHECK_INTERVAL = std::chrono::milliseconds(100);
+
+double cpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double processCpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+        + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+void produce(const std::string& name, size_t frameBytes, double fps, const std::atomic<bool>& running)
+{
+    egl::BrokerClient broker(SOCKET_PATH);
+    egl::SharedChannel channel(broker.attach(name, egl::Role::producer, frameBytes, SLOT_COUNT).shmName);
+    std::vector<uint8_t> frame(frameBytes, 0x5a);
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1 / fps));
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        std::this_thread::sleep_until(next);
+        // A late producer skips frames instead of catching up in a burst.
+        next = std::max(next + period, std::chrono::steady_clock::now());
+        if (!channel.tryWrite(frame.data(), frame.size())) {
+            channel.recordDrop();
+        }
+    }
+}
+
+void consume(const std::string& name, size_t frameBytes, const std::atomic<bool>& running)
+{
+    egl::BrokerClient broker(SOCKET_PATH);
+    egl::SharedChannel channel(broker.attach(name, egl::Role::consumer, frameBytes, SLOT_COUNT).shmName);
+    std::vector<uint8_t> frame(frameBytes);
+    egl::SlotHeader header;
+    while (running) {
+        if (!channel.tryRead(frame.data(), frame.size(), header)) {
+            channel.waitRead(STOP_CHECK_INTERVAL);
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    size_t frameBytes = argc > 2 ? atol(argv[2]) : 640 * 480 * 3;
+    double fps = argc > 3 ? atof(argv[3]) : 30;
+
+    egl::Broker broker(SOCKET_PATH);
+    std::thread brokerThread([&broker]() { broker.run(); });
+    clockid_t brokerClock;
+    pthread_getcpuclockid(brokerThread.native_handle(), &brokerClock);
+
+    std::cout << "frame bytes: " << frameBytes << ", " << fps << " fps per channel, "
+        << seconds << " s per step" << std::endl;
+    std::cout << std::setw(9) << "channels"
+        << std::setw(12) << "frames/s"
+        << std::setw(12) << "MB/s"
+        << std::setw(8) << "drops"
+        << std::setw(10) << "cpu %"
+        << std::setw(14) << "cpu us/frame"
+        << std::setw(12) << "cpu ms/MB"
+        << std::setw(14) << "broker cpu ms"
+        << std::setw(14) << "query us" << std::endl;
+
+    for (int channels = 1; channels <= 64; channels *= 2) {
+        std::atomic<bool> running{true};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < channels; ++i) {
+            auto name = "bench" + std::to_string(i);
+            threads.emplace_back(produce, name, frameBytes, fps, std::cref(running));
+            threads.emplace_back(consume, name, frameBytes, std::cref(running));
+        }
+
+        egl::BrokerClient monitor(SOCKET_PATH);
+        while (monitor.list().size() != static_cast<size_t>(channels)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        auto totals = [&]() {
+            egl::ChannelStats total;
+            for (int i = 0; i < channels; ++i) {
+                auto stats = monitor.query("bench" + std::to_string(i)).stats;
+                total.framesRead += stats.framesRead;
+                total.drops += stats.drops;
+            }
+            return total;
+        };
+
+        auto startStats = totals();
+        double startCpu = processCpuSeconds();
+        double startBrokerCpu = cpuSeconds(brokerClock);
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+        auto queryStart = std::chrono::steady_clock::now();
+        auto endStats = totals();
+        uint64_t frames = endStats.framesRead - startStats.framesRead;
+        uint64_t drops = endStats.drops - startStats.drops;
+        auto end = std::chrono::steady_clock::now();
+        double brokerCpu = cpuSeconds(brokerClock) - startBrokerCpu;
+        double cpu = processCpuSeconds() - startCpu;
+
+        running = false;
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        double wall = std::chrono::duration<double>(end - start).count();
+        double queryUs = std::chrono::duration<double, std::micro>(end - queryStart).count() / channels;
+        double megabytes = frames * frameBytes / 1e6;
+        std::cout << std::setw(9) << channels
+            << std::setw(12) << std::fixed << std::setprecision(0) << frames / wall
+            << std::setw(12) << std::setprecision(1) << megabytes / wall
+            << std::setw(8) << drops
+            << std::setw(10) << 100 * cpu / wall
+            << std::setw(14) << (frames ? cpu * 1e6 / frames : 0)
+            << std::setw(12) << std::setprecision(3) << (frames ? cpu * 1e3 / megabytes : 0)
+            << std::setprecision(1)
+            << std::setw(14) << brokerCpu * 1e3
+            << std::setw(14) << queryUs << std::endl;
+    }
+
+    broker.stop();
+    brokerThread.join();
+    return 0;
+}
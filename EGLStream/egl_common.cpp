@@ -99,6 +99,10 @@ Socket::Socket(const std::string& socketName, bool isServer)
     sockaddr_un addr;
     memset(&addr, 0, sizeof(addr));
     addr.sun_family = AF_UNIX;
+    if (socketName.size() >= sizeof(addr.sun_path)) {
+        close(fd_);
+        throw Error("Socket path is too long: " + socketName);
+    }
     strcpy(addr.sun_path, socketName.data());
 
     if (isServer) {
@@ -4,6 +4,8 @@
 
 #include <stdexcept>
 
+#include "EGLStream/error.h"
+
 #define CHECK(expr) \
     if (!(expr)) { \
         throw egl::Error(#expr " is false"); \
@@ -21,14 +23,6 @@ typedef EGLBoolean (*eglQueryStreamKHR_type) (
     EGLDisplay, EGLStreamKHR,
     EGLenum, EGLint*);
 
-class Error : public std::runtime_error
-{
-public:
-    explicit Error(const std::string what)
-        : std::runtime_error(what)
-    {}
-};
-
 class Framework {
 public:
     Framework();
@@ -0,0 +1,15 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+
+namespace egl {
+
+class Error : public std::runtime_error
+{
+public:
+    explicit Error(const std::string what)
+        : std::runtime_error(what)
+    {}
+};
+
+}
@@ -0,0 +1,68 @@
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "EGLStream/error.h"
+#include "EGLStream/stream_broker.h"
+
+namespace {
+
+egl::Broker* broker = nullptr;
+
+void onSignal(int)
+{
+    if (broker) {
+        broker->stop();
+    }
+}
+
+int printStats(const std::string& socketPath)
+{
+    egl::BrokerClient client(socketPath);
+    std::cout << std::left
+        << std::setw(16) << "channel"
+        << std::setw(6) << "prod"
+        << std::setw(6) << "cons"
+        << std::setw(14) << "written"
+        << std::setw(14) << "read"
+        << std::setw(16) << "bytes"
+        << "drops" << std::endl;
+    for (const auto& name : client.list()) {
+        auto info = client.query(name);
+        std::cout
+            << std::setw(16) << name
+            << std::setw(6) << info.producers
+            << std::setw(6) << info.consumers
+            << std::setw(14) << info.stats.framesWritten
+            << std::setw(14) << info.stats.framesRead
+            << std::setw(16) << info.stats.bytesWritten
+            << info.stats.drops << std::endl;
+    }
+    return 0;
+}
+
+}
+
+// Usage:
+//   egl_broker [socket]        serve channel registry
+//   egl_broker stats [socket]  print statistics of all channels
+int main(int argc, char** argv) {
+    try {
+        if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+            return printStats(argc > 2 ? argv[2] : egl::DEFAULT_BROKER_SOCKET);
+        }
+
+        egl::Broker server(argc > 1 ? argv[1] : egl::DEFAULT_BROKER_SOCKET);
+        broker = &server;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::cerr << "Broker is running" << std::endl;
+        server.run();
+        broker = nullptr;
+    } catch (const egl::Error& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
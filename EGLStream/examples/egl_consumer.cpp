@@ -5,17 +5,33 @@
 #include <chrono>
 
 #include "EGLStream/egl_common.h"
+#include "EGLStream/stream_broker.h"
+#include "realtime/realtime.h"
 #include <opencv2/core/cuda.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 
 using namespace std::chrono_literals;
 
+const cv::Size MAX_FRAME_SIZE{1920, 1080};
+
 int main(int argc, char** argv) {
+    rt::Config rtConfig;
+    try {
+        rtConfig = rt::parseArgs(argc, argv);
+        rt::checkStages(rtConfig, 1);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl
+            << "Usage: " << argv[0] << " " << rt::USAGE << " [<channel>]" << std::endl;
+        return 1;
+    }
+    rt::enterProcess(rtConfig);
+
     egl::Display display;
     egl::Framework eglFramework;
 
-    egl::Stream eglStream("/tmp/egl-stream.sock", egl::Stream::Endpoint::consumer, eglFramework, display);
+    auto endpoint = egl::attachStream(argc > 1 ? argv[1] : "", egl::Role::consumer);
+    egl::Stream eglStream(endpoint.socketPath, egl::Stream::Endpoint::consumer, eglFramework, display);
 
 
     EGLint streamState = 0;
@@ -61,30 +77,40 @@ int main(int argc, char** argv) {
 
 
     cv::namedWindow("Frame", cv::WINDOW_NORMAL);
+    // Frames are downloaded into a view of this buffer, so the loop neither
+    // allocates nor takes page faults for frames up to its size.
+    cv::Mat frameBuffer(MAX_FRAME_SIZE, CV_8UC3);
+    rt::prefault(rtConfig, frameBuffer.data, frameBuffer.step * frameBuffer.rows);
+    rt::FrameIntervals intervals;
+    rt::enterStage(rtConfig, 0);
     while(true) {
-        do {
-            streamState = eglStream.queryState();
-            std::cout << std::hex << "Waiting for frames. Stream state: " << streamState << std::endl;
-            if(cv::waitKey(5) == 27) {
-                break;
-            }
-            std::this_thread::sleep_for(30ms);
-        } while(streamState != EGL_STREAM_STATE_NEW_FRAME_AVAILABLE_KHR && streamState != EGL_STREAM_STATE_DISCONNECTED_KHR);
-
-        if (streamState == EGL_STREAM_STATE_DISCONNECTED_KHR) {
-            std::cout << "Stream disconnected" << std::endl;
-            break;
-        }
-
+        // Waits in the acquire call rather than polling the stream state,
+        // so frame intervals are not rounded up to a polling period.
         CUgraphicsResource cudaResource;
         cudaResult = cuEGLStreamConsumerAcquireFrame(&eglCudaConnection, &cudaResource, &cudaStream, 16000);
         if (cudaResult != CUDA_SUCCESS) {
+            streamState = eglStream.queryState();
+            if (streamState == EGL_STREAM_STATE_DISCONNECTED_KHR) {
+                std::cout << "Stream disconnected" << std::endl;
+                break;
+            }
+            if (cudaResult == CUDA_ERROR_LAUNCH_TIMEOUT) {
+                std::cout << std::hex << "Waiting for frames. Stream state: " << streamState << std::endl;
+                if (cv::waitKey(1) == 27) {
+                    break;
+                }
+                continue;
+            }
             const char* error;
             cuGetErrorString(cudaResult, &error);
             std::cout << "Can not acquire cuda frame: " << error << std::endl;
             return -1;
         }
         std::cout << "Frame acquired" << std::endl;
+        intervals.tick();
+        if (endpoint.channel) {
+            endpoint.channel->recordRead();
+        }
 
         CUeglFrame eglFrame;
         cudaResult = cuGraphicsResourceGetMappedEglFrame(&eglFrame, cudaResource, 0, 0);
@@ -95,10 +121,12 @@ int main(int argc, char** argv) {
             return -1;
         }
 
-        cv::Mat cpuMat;
-
         {
             cv::cuda::GpuMat frameWrapper(eglFrame.height, eglFrame.width, CV_8UC3, eglFrame.frame.pPitch[0], eglFrame.pitch);
+            cv::Size frameSize(eglFrame.width, eglFrame.height);
+            cv::Mat cpuMat = frameSize.width <= frameBuffer.cols && frameSize.height <= frameBuffer.rows
+                ? frameBuffer(cv::Rect(cv::Point(), frameSize))
+                : cv::Mat();
             frameWrapper.download(cpuMat);
             cv::imshow("Camera frame", cpuMat);
         }
@@ -111,8 +139,13 @@ int main(int argc, char** argv) {
             return -1;
         }
         std::cout << "Frame released" << std::endl;
+        if (cv::waitKey(1) == 27) {
+            break;
+        }
     }
 
+    intervals.histogram().print(std::cout, "Frame intervals");
+
     cudaResult = cuEGLStreamConsumerDisconnect(&eglCudaConnection);
     if (cudaResult != CUDA_SUCCESS) {
         std::cout << "Can not disconnect consumer from eglStream" << std::endl;
@@ -3,6 +3,8 @@
 #include <iostream>
 
 #include "EGLStream/egl_common.h"
+#include "EGLStream/stream_broker.h"
+#include "realtime/realtime.h"
 #include <thread>
 #include <chrono>
 #include <opencv2/videoio.hpp>
@@ -15,10 +17,22 @@ constexpr int WIDTH = 720;
 constexpr int HEIGHT = 480;
 
 int main(int argc, char** argv) {
+    rt::Config rtConfig;
+    try {
+        rtConfig = rt::parseArgs(argc, argv);
+        rt::checkStages(rtConfig, 1);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl
+            << "Usage: " << argv[0] << " " << rt::USAGE << " [<channel>]" << std::endl;
+        return 1;
+    }
+    rt::enterProcess(rtConfig);
+
     egl::Display display;
     egl::Framework eglFramework;
 
-    egl::Stream eglStream("/tmp/egl-stream.sock", egl::Stream::Endpoint::producer, eglFramework, display);
+    auto endpoint = egl::attachStream(argc > 1 ? argv[1] : "", egl::Role::producer);
+    egl::Stream eglStream(endpoint.socketPath, egl::Stream::Endpoint::producer, eglFramework, display);
 
     EGLint streamState = 0;
     do {
@@ -59,6 +73,7 @@ int main(int argc, char** argv) {
     cv::Mat frame;
     cv::cuda::GpuMat gpuFrame;
     cap >> frame;
+    rt::FrameIntervals intervals;
 
     CUeglStreamConnection eglCudaConnection;
     cudaResult = cuEGLStreamProducerConnect(&eglCudaConnection, eglStream.get(), frame.size().width, frame.size().height);
@@ -69,6 +84,7 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    rt::enterStage(rtConfig, 0);
     while (eglStream.queryState() != EGL_STREAM_STATE_DISCONNECTED_KHR) {
         gpuFrame.upload(frame);
         CHECK(gpuFrame.type() == CV_8UC3);
@@ -102,6 +118,10 @@ int main(int argc, char** argv) {
             return -1;
         }
 
+        intervals.tick();
+        if (endpoint.channel) {
+            endpoint.channel->recordWrite(gpuFrame.step * gpuFrame.rows);
+        }
         std::cout << "Presented frame..." << std::endl;
         cap >> frame;
         std::cout << "Captured next frame" << std::endl;
@@ -128,6 +148,7 @@ int main(int argc, char** argv) {
             break;
         }
     }
+    intervals.histogram().print(std::cout, "Frame intervals");
     std::this_thread::sleep_for(3s);
     cudaResult = cuEGLStreamProducerDisconnect(&eglCudaConnection);
     if (cudaResult != CUDA_SUCCESS) {
@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "EGLStream/load_test/load_harness.h"
+
+// Sweeps resolution, pixel format, FIFO depth and consumer speed over the
+// shared memory transport with producer and consumer in separate processes.
+//
+// Usage: load_benchmark [frames per run] [threads|processes]
+
+using namespace std::chrono_literals;
+
+int main(int argc, char** argv) {
+    egl::LoadConfig config;
+    config.frames = argc > 1 ? atol(argv[1]) : 300;
+    std::string mode = argc > 2 ? argv[2] : "processes";
+    if (mode == "threads") {
+        config.mode = egl::LoadMode::threads;
+    } else if (mode == "processes") {
+        config.mode = egl::LoadMode::processes;
+    } else {
+        std::cerr << "Usage: " << argv[0] << " [frames per run] [threads|processes]" << std::endl;
+        return 1;
+    }
+
+    auto ms = [](std::chrono::nanoseconds value) { return value.count() / 1e6; };
+    std::cout << std::left << std::setw(56) << "configuration" << std::right
+        << std::setw(9) << "fps"
+        << std::setw(9) << "MB/s"
+        << std::setw(8) << "drops"
+        << std::setw(8) << "errors"
+        << std::setw(10) << "p50 ms"
+        << std::setw(10) << "p99 ms"
+        << std::setw(10) << "p99.9 ms" << std::endl;
+
+    const std::pair<int, int> resolutions[] = {{640, 480}, {1280, 720}, {1920, 1080}};
+    const egl::PixelFormat formats[] = {egl::PixelFormat::nv12, egl::PixelFormat::rgb24};
+    const size_t depths[] = {1, 4, 8};
+    // Free running consumer, and one too slow for a 60 fps producer.
+    const std::pair<double, std::chrono::microseconds> speeds[] = {{0, 0us}, {60, 20000us}};
+
+    for (auto resolution : resolutions) {
+        for (auto format : formats) {
+            for (auto depth : depths) {
+                for (auto speed : speeds) {
+                    config.width = resolution.first;
+                    config.height = resolution.second;
+                    config.format = format;
+                    config.fifoDepth = depth;
+                    config.producerFps = speed.first;
+                    config.consumerDelay = speed.second;
+
+                    auto result = egl::runLoad(config);
+                    auto bytes = egl::frameBytes(config.width, config.height, config.format);
+                    std::cout << std::left << std::setw(56) << egl::describe(config) << std::right
+                        << std::fixed << std::setprecision(1)
+                        << std::setw(9) << result.fps()
+                        << std::setw(9) << result.fps() * bytes / 1e6
+                        << std::setw(8) << result.drops
+                        << std::setw(8) << result.corrupt + result.reordered + result.lost
+                        << std::setprecision(3)
+                        << std::setw(10) << ms(result.latency.percentile(50))
+                        << std::setw(10) << ms(result.latency.percentile(99))
+                        << std::setw(10) << ms(result.latency.percentile(99.9)) << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
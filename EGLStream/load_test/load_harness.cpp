@@ -0,0 +1,356 @@
+#include "load_harness.h"
+#include "EGLStream/error.h"
+#include "EGLStream/shared_channel.h"
+
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace egl {
+
+namespace {
+
+// A consumer which got nothing for this long assumes the producer is gone,
+// a producer which could not write for this long assumes the same of the consumer.
+constexpr auto IDLE_TIMEOUT = std::chrono::seconds(5);
+
+struct ConsumerResult {
+    uint64_t received;
+    uint64_t corrupt;
+    uint64_t reordered;
+    uint64_t gaps;
+    bool timedOut;
+    std::chrono::steady_clock::time_point end;
+    rt::JitterHistogram latency;
+};
+
+static_assert(std::is_trivially_copyable<ConsumerResult>::value,
+    "ConsumerResult is passed between processes as raw bytes");
+
+uint64_t patternWord(uint64_t sequence, uint64_t index)
+{
+    return (sequence + 1) * 0x9e3779b97f4a7c15ull ^ index;
+}
+
+uint64_t checksum(const uint8_t* data, size_t size)
+{
+    uint64_t result = 0xcbf29ce484222325ull;
+    size_t words = size / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        memcpy(&word, data + i * sizeof(word), sizeof(word));
+        result = ((result << 5) | (result >> 59)) ^ word;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < size; ++i) {
+        result = ((result << 5) | (result >> 59)) ^ data[i];
+    }
+    return result;
+}
+
+std::string channelName()
+{
+    static int counter = 0;
+    return "/egl-load-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+}
+
+void produce(SharedChannel& channel, const LoadConfig& config, size_t size)
+{
+    std::vector<uint8_t> frame(size);
+    auto period = config.producerFps > 0
+        ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1 / config.producerFps))
+        : std::chrono::steady_clock::duration::zero();
+    auto next = std::chrono::steady_clock::now();
+
+    // Sequence number config.frames is the end marker, it is never dropped.
+    for (uint64_t sequence = 0; sequence <= config.frames; ++sequence) {
+        bool last = sequence == config.frames;
+        if (config.producerFps > 0) {
+            std::this_thread::sleep_until(next);
+            next += period;
+        }
+        fillFrame(frame.data(), frame.size(), sequence);
+        while (!channel.tryWrite(frame.data(), frame.size())) {
+            if (config.producerFps > 0 && !last) {
+                channel.recordDrop();
+                break;
+            }
+            if (!channel.waitWrite(IDLE_TIMEOUT)) {
+                throw Error("Consumer stopped reading");
+            }
+        }
+    }
+}
+
+ConsumerResult consume(SharedChannel& channel, const LoadConfig& config, size_t size)
+{
+    ConsumerResult result{};
+    std::vector<uint8_t> frame(size);
+    SlotHeader slot;
+    uint64_t expected = 0;
+
+    for (;;) {
+        if (!channel.tryRead(frame.data(), frame.size(), slot)) {
+            if (!channel.waitRead(IDLE_TIMEOUT)) {
+                result.timedOut = true;
+                break;
+            }
+            continue;
+        }
+
+        FrameHeader header;
+        if (!checkFrame(frame.data(), slot.size, header)) {
+            ++result.corrupt;
+            continue;
+        }
+        if (header.sequence == config.frames) {
+            break;
+        }
+        result.latency.record(std::chrono::nanoseconds(nowNs() - header.timestampNs));
+        ++result.received;
+        if (header.sequence < expected) {
+            ++result.reordered;
+        } else {
+            result.gaps += header.sequence - expected;
+            expected = header.sequence + 1;
+        }
+
+        if (config.consumerDelay.count() > 0) {
+            std::this_thread::sleep_for(config.consumerDelay);
+        }
+    }
+    result.gaps += config.frames > expected ? config.frames - expected : 0;
+    result.end = std::chrono::steady_clock::now();
+    return result;
+}
+
+ConsumerResult runThreads(SharedChannel& channel, const LoadConfig& config, size_t size)
+{
+    ConsumerResult result;
+    std::thread consumer([&]() { result = consume(channel, config, size); });
+    try {
+        produce(channel, config, size);
+    } catch (...) {
+        consumer.join();
+        throw;
+    }
+    consumer.join();
+    return result;
+}
+
+pid_t spawn(const std::function<void()>& body)
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        throw Error(std::string("Can not fork: ") + strerror(errno));
+    }
+    if (pid == 0) {
+        int status = 0;
+        try {
+            body();
+        } catch (const std::exception&) {
+            status = 1;
+        }
+        _exit(status);
+    }
+    return pid;
+}
+
+bool exitedCleanly(pid_t pid)
+{
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Pipe transfers larger than PIPE_BUF may be split, so both sides loop.
+bool writeAll(int fd, const void* data, size_t size)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        auto count = write(fd, bytes, size);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Returns false on EOF or error before size bytes were read.
+bool readAll(int fd, void* data, size_t size)
+{
+    auto bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        auto count = read(fd, bytes, size);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+ConsumerResult runProcesses(const std::string& shmName, const LoadConfig& config, size_t size)
+{
+    int resultPipe[2];
+    if (pipe(resultPipe) == -1) {
+        throw Error("Can not create pipe");
+    }
+
+    pid_t consumer = spawn([&]() {
+        close(resultPipe[0]);
+        SharedChannel channel(shmName);
+        ConsumerResult result = consume(channel, config, size);
+        if (!writeAll(resultPipe[1], &result, sizeof(result))) {
+            throw Error("Can not report consumer result");
+        }
+    });
+    close(resultPipe[1]);
+
+    pid_t producer = -1;
+    try {
+        producer = spawn([&]() {
+            SharedChannel channel(shmName);
+            produce(channel, config, size);
+        });
+    } catch (...) {
+        // Consumer gives up after IDLE_TIMEOUT without a producer.
+        close(resultPipe[0]);
+        exitedCleanly(consumer);
+        throw;
+    }
+
+    ConsumerResult result;
+    bool reported = readAll(resultPipe[0], &result, sizeof(result));
+    close(resultPipe[0]);
+    // Both children are reaped before any of them is reported as failed.
+    bool producerOk = exitedCleanly(producer);
+    bool consumerOk = exitedCleanly(consumer);
+    if (!producerOk) {
+        throw Error("Producer process failed");
+    }
+    if (!consumerOk) {
+        throw Error("Consumer process failed");
+    }
+    if (!reported) {
+        throw Error("Consumer did not report result");
+    }
+    return result;
+}
+
+}
+
+const char* formatName(PixelFormat format)
+{
+    switch (format) {
+    case PixelFormat::gray8: return "GRAY8";
+    case PixelFormat::nv12: return "NV12";
+    case PixelFormat::yuyv: return "YUYV";
+    case PixelFormat::rgb24: return "RGB24";
+    case PixelFormat::rgba32: return "RGBA32";
+    }
+    return "unknown";
+}
+
+size_t frameBytes(int width, int height, PixelFormat format)
+{
+    size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+    case PixelFormat::gray8: return pixels;
+    case PixelFormat::nv12: return pixels * 3 / 2;
+    case PixelFormat::yuyv: return pixels * 2;
+    case PixelFormat::rgb24: return pixels * 3;
+    case PixelFormat::rgba32: return pixels * 4;
+    }
+    throw Error("Unknown pixel format");
+}
+
+void fillFrame(uint8_t* frame, size_t size, uint64_t sequence)
+{
+    if (size < sizeof(FrameHeader)) {
+        throw Error("Frame is smaller than its header");
+    }
+    uint8_t* payload = frame + sizeof(FrameHeader);
+    size_t payloadSize = size - sizeof(FrameHeader);
+    size_t words = payloadSize / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word = patternWord(sequence, i);
+        memcpy(payload + i * sizeof(word), &word, sizeof(word));
+    }
+    for (size_t i = words * sizeof(uint64_t); i < payloadSize; ++i) {
+        payload[i] = static_cast<uint8_t>(sequence + i);
+    }
+
+    FrameHeader header{sequence, nowNs(), checksum(payload, payloadSize), size};
+    memcpy(frame, &header, sizeof(header));
+}
+
+bool checkFrame(const uint8_t* frame, size_t size, FrameHeader& header)
+{
+    if (size < sizeof(FrameHeader)) {
+        return false;
+    }
+    memcpy(&header, frame, sizeof(header));
+    if (header.size != size) {
+        return false;
+    }
+    return header.checksum == checksum(frame + sizeof(FrameHeader), size - sizeof(FrameHeader));
+}
+
+LoadResult runLoad(const LoadConfig& config)
+{
+    size_t size = frameBytes(config.width, config.height, config.format);
+    SharedChannel channel(channelName(), size, config.fifoDepth);
+
+    auto start = std::chrono::steady_clock::now();
+    ConsumerResult consumed = config.mode == LoadMode::threads
+        ? runThreads(channel, config, size)
+        : runProcesses(channel.name(), config, size);
+
+    auto stats = channel.stats();
+    LoadResult result;
+    // End marker is not a payload frame.
+    result.sent = stats.framesWritten > 0 ? stats.framesWritten - 1 : 0;
+    result.drops = stats.drops;
+    result.received = consumed.received;
+    result.corrupt = consumed.corrupt;
+    result.reordered = consumed.reordered;
+    result.lost = consumed.gaps > stats.drops ? consumed.gaps - stats.drops : 0;
+    result.timedOut = consumed.timedOut;
+    result.seconds = std::chrono::duration<double>(consumed.end - start).count();
+    result.latency = consumed.latency;
+    return result;
+}
+
+std::string describe(const LoadConfig& config)
+{
+    std::ostringstream out;
+    out << config.width << "x" << config.height
+        << " " << formatName(config.format)
+        << " fifo=" << config.fifoDepth
+        << " fps=" << config.producerFps
+        << " delay=" << config.consumerDelay.count() << "us"
+        << " " << (config.mode == LoadMode::threads ? "threads" : "processes");
+    return out.str();
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "realtime/realtime.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace egl {
+
+enum class PixelFormat {
+    gray8,
+    nv12,
+    yuyv,
+    rgb24,
+    rgba32
+};
+
+const char* formatName(PixelFormat format);
+size_t frameBytes(int width, int height, PixelFormat format);
+
+// Synthetic frames start with this header; the rest is a pattern derived
+// from the sequence number.
+struct FrameHeader {
+    uint64_t sequence;
+    uint64_t timestampNs;
+    uint64_t checksum;
+    uint64_t size;
+};
+
+void fillFrame(uint8_t* frame, size_t size, uint64_t sequence);
+// Returns false if the frame is truncated or its checksum does not match.
+bool checkFrame(const uint8_t* frame, size_t size, FrameHeader& header);
+
+enum class LoadMode {
+    threads,
+    processes
+};
+
+struct LoadConfig {
+    int width = 640;
+    int height = 480;
+    PixelFormat format = PixelFormat::rgb24;
+    size_t fifoDepth = 4;
+    uint64_t frames = 300;
+    // Frame rate of the producer. When the FIFO is full a paced producer
+    // drops the frame, like a camera does. Zero means "as fast as possible",
+    // the producer then waits for a free slot and never drops.
+    double producerFps = 0;
+    // Simulated processing time of every frame in the consumer.
+    std::chrono::microseconds consumerDelay{0};
+    LoadMode mode = LoadMode::threads;
+};
+
+struct LoadResult {
+    uint64_t sent = 0;
+    uint64_t drops = 0;
+    uint64_t received = 0;
+    uint64_t corrupt = 0;
+    uint64_t reordered = 0;
+    // Sequence gaps seen by the consumer which are not producer drops.
+    uint64_t lost = 0;
+    bool timedOut = false;
+    double seconds = 0;
+    rt::JitterHistogram latency;
+
+    double fps() const { return seconds > 0 ? received / seconds : 0; }
+};
+
+// Runs producer and consumer over a GPU-free shared memory channel
+// and checks integrity of every received frame.
+LoadResult runLoad(const LoadConfig& config);
+
+std::string describe(const LoadConfig& config);
+
+}
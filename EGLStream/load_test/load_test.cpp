@@ -0,0 +1,84 @@
+#include <gmock/gmock.h>
+
+#include "EGLStream/load_test/load_harness.h"
+
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+void expectIntact(const egl::LoadResult& result)
+{
+    EXPECT_FALSE(result.timedOut);
+    EXPECT_EQ(0u, result.corrupt);
+    EXPECT_EQ(0u, result.reordered);
+    EXPECT_EQ(0u, result.lost);
+    EXPECT_EQ(result.sent, result.received);
+}
+
+}
+
+TEST(SyntheticFrameTest, detectsCorruption)
+{
+    std::vector<uint8_t> frame(egl::frameBytes(33, 7, egl::PixelFormat::nv12));
+    egl::fillFrame(frame.data(), frame.size(), 42);
+
+    egl::FrameHeader header;
+    ASSERT_TRUE(egl::checkFrame(frame.data(), frame.size(), header));
+    EXPECT_EQ(42u, header.sequence);
+
+    frame.back() ^= 1;
+    EXPECT_FALSE(egl::checkFrame(frame.data(), frame.size(), header));
+    EXPECT_FALSE(egl::checkFrame(frame.data(), frame.size() - 1, header));
+}
+
+TEST(LoadTest, sweepWithoutDrops)
+{
+    for (auto format : {egl::PixelFormat::gray8, egl::PixelFormat::nv12, egl::PixelFormat::rgba32}) {
+        for (auto size : {std::make_pair(320, 240), std::make_pair(1280, 720)}) {
+            for (size_t depth : {1, 4}) {
+                egl::LoadConfig config;
+                config.width = size.first;
+                config.height = size.second;
+                config.format = format;
+                config.fifoDepth = depth;
+                config.frames = 50;
+                SCOPED_TRACE(egl::describe(config));
+
+                auto result = egl::runLoad(config);
+                expectIntact(result);
+                EXPECT_EQ(config.frames, result.received);
+                EXPECT_EQ(0u, result.drops);
+            }
+        }
+    }
+}
+
+TEST(LoadTest, processesWithoutDrops)
+{
+    egl::LoadConfig config;
+    config.mode = egl::LoadMode::processes;
+    config.frames = 100;
+
+    auto result = egl::runLoad(config);
+    expectIntact(result);
+    EXPECT_EQ(config.frames, result.received);
+    EXPECT_GT(result.latency.count(), 0u);
+}
+
+TEST(LoadTest, slowConsumerDropsFrames)
+{
+    egl::LoadConfig config;
+    config.width = 320;
+    config.height = 240;
+    config.producerFps = 500;
+    config.consumerDelay = 10ms;
+    config.fifoDepth = 2;
+    config.frames = 100;
+
+    auto result = egl::runLoad(config);
+    expectIntact(result);
+    EXPECT_GT(result.drops, 0u);
+    EXPECT_EQ(config.frames, result.sent + result.drops);
+}
@@ -0,0 +1,301 @@
+#include "shared_channel.h"
+#include "error.h"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace egl {
+
+namespace {
+
+constexpr uint32_t CHANNEL_MAGIC = 0x45474c43;  // "EGLC"
+constexpr size_t CACHE_LINE = 64;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Futexes are shared between processes, so no FUTEX_PRIVATE_FLAG.
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be plain 32 bits");
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    timespec ts;
+    ts.tv_sec = seconds.count();
+    ts.tv_nsec = (timeout - seconds).count();
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Waiter side of a futex protected condition. The signal is read before the
+// condition, so a change between the check and the wait makes the wait
+// return at once; the waiter count lets the signalling side skip the wake
+// call while nobody sleeps.
+template<class Condition>
+bool waitFor(std::atomic<uint32_t>& signal, std::atomic<uint32_t>& waiters,
+        std::chrono::nanoseconds timeout, Condition condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        uint32_t seen = signal.load();
+        if (condition()) {
+            return true;
+        }
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::nanoseconds::zero()) {
+            return false;
+        }
+        waiters.fetch_add(1);
+        futexWait(signal, seen, remaining);
+        waiters.fetch_sub(1);
+    }
+}
+
+void notify(std::atomic<uint32_t>& signal, std::atomic<uint32_t>& waiters)
+{
+    signal.fetch_add(1);
+    if (waiters.load() > 0) {
+        futexWake(signal);
+    }
+}
+
+}
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Indices are kept on separate cache lines, so producer and consumer
+// do not invalidate each other on every frame.
+struct SharedChannel::Header {
+    uint32_t magic;
+    uint64_t slotSize;
+    uint64_t slotCount;
+    uint64_t slotStride;
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> writeIndex;
+    std::atomic<uint64_t> framesWritten;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> drops;
+    // Bumped on every write, consumers sleep on it.
+    std::atomic<uint32_t> writeSignal;
+    std::atomic<uint32_t> writerWaiters;
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> readIndex;
+    std::atomic<uint64_t> framesRead;
+    // Bumped on every read, producers sleep on it.
+    std::atomic<uint32_t> readSignal;
+    std::atomic<uint32_t> readerWaiters;
+};
+
+bool SharedChannel::validLayout(size_t slotSize, size_t slotCount)
+{
+    // Limits keep the size arithmetic below far from overflow.
+    if (slotSize > MAX_SLOT_SIZE || slotCount > MAX_SLOT_COUNT) {
+        return false;
+    }
+    size_t stride = alignUp(sizeof(SlotHeader) + slotSize, CACHE_LINE);
+    return alignUp(sizeof(Header), CACHE_LINE) + stride * slotCount <= MAX_SEGMENT_SIZE;
+}
+
+SharedChannel::SharedChannel(const std::string& shmName, size_t slotSize, size_t slotCount)
+    : name_(shmName)
+    , owner_(true)
+{
+    if (!validLayout(slotSize, slotCount)) {
+        throw Error("Slot layout of " + name_ + " is too large");
+    }
+    // Segment may be left over from a crashed broker.
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        throw Error("Can not create shared memory " + name_ + ": " + strerror(errno));
+    }
+
+    size_t stride = alignUp(sizeof(SlotHeader) + slotSize, CACHE_LINE);
+    size_t size = alignUp(sizeof(Header), CACHE_LINE) + stride * slotCount;
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        shm_unlink(name_.c_str());
+        throw Error("Can not resize shared memory " + name_ + ": " + strerror(errno));
+    }
+    map(fd, size);
+
+    header_ = new (header_) Header();
+    header_->slotSize = slotSize;
+    header_->slotCount = slotCount;
+    header_->slotStride = stride;
+    slotStride_ = stride;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = CHANNEL_MAGIC;
+}
+
+SharedChannel::SharedChannel(const std::string& shmName)
+    : name_(shmName)
+    , owner_(false)
+{
+    int fd = shm_open(name_.c_str(), O_RDWR, 0);
+    if (fd == -1) {
+        throw Error("Can not open shared memory " + name_ + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        throw Error("Shared memory " + name_ + " is not a channel");
+    }
+    map(fd, st.st_size);
+
+    if (header_->magic != CHANNEL_MAGIC) {
+        munmap(header_, mappedSize_);
+        throw Error("Shared memory " + name_ + " is not a channel");
+    }
+    slotStride_ = header_->slotStride;
+}
+
+SharedChannel::~SharedChannel()
+{
+    munmap(header_, mappedSize_);
+    if (owner_) {
+        shm_unlink(name_.c_str());
+    }
+}
+
+void SharedChannel::map(int fd, size_t size)
+{
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+        throw Error("Can not map shared memory " + name_ + ": " + strerror(errno));
+    }
+    mappedSize_ = size;
+    header_ = static_cast<Header*>(addr);
+    slots_ = static_cast<uint8_t*>(addr) + alignUp(sizeof(Header), CACHE_LINE);
+}
+
+uint8_t* SharedChannel::slot(uint64_t index) const
+{
+    return slots_ + (index % header_->slotCount) * slotStride_;
+}
+
+bool SharedChannel::tryWrite(const void* data, size_t size)
+{
+    if (size > header_->slotSize || header_->slotCount == 0) {
+        throw Error("Frame does not fit into channel " + name_);
+    }
+    uint64_t write = header_->writeIndex.load(std::memory_order_relaxed);
+    uint64_t read = header_->readIndex.load(std::memory_order_acquire);
+    if (write - read >= header_->slotCount) {
+        return false;
+    }
+
+    uint8_t* target = slot(write);
+    SlotHeader slotHeader{write, size, nowNs()};
+    memcpy(target, &slotHeader, sizeof(slotHeader));
+    memcpy(target + sizeof(slotHeader), data, size);
+    header_->writeIndex.store(write + 1, std::memory_order_release);
+    notify(header_->writeSignal, header_->readerWaiters);
+
+    recordWrite(size);
+    return true;
+}
+
+bool SharedChannel::tryRead(void* data, size_t capacity, SlotHeader& header)
+{
+    uint64_t read = header_->readIndex.load(std::memory_order_relaxed);
+    uint64_t write = header_->writeIndex.load(std::memory_order_acquire);
+    if (read == write) {
+        return false;
+    }
+
+    const uint8_t* source = slot(read);
+    memcpy(&header, source, sizeof(header));
+    if (header.size > capacity) {
+        throw Error("Frame does not fit into read buffer");
+    }
+    memcpy(data, source + sizeof(header), header.size);
+    header_->readIndex.store(read + 1, std::memory_order_release);
+    notify(header_->readSignal, header_->writerWaiters);
+
+    recordRead();
+    return true;
+}
+
+bool SharedChannel::canWrite() const
+{
+    uint64_t write = header_->writeIndex.load(std::memory_order_relaxed);
+    return write - header_->readIndex.load(std::memory_order_acquire) < header_->slotCount;
+}
+
+bool SharedChannel::canRead() const
+{
+    uint64_t read = header_->readIndex.load(std::memory_order_relaxed);
+    return read != header_->writeIndex.load(std::memory_order_acquire);
+}
+
+bool SharedChannel::waitWrite(std::chrono::nanoseconds timeout)
+{
+    return waitFor(header_->readSignal, header_->writerWaiters, timeout, [this]() { return canWrite(); });
+}
+
+bool SharedChannel::waitRead(std::chrono::nanoseconds timeout)
+{
+    return waitFor(header_->writeSignal, header_->readerWaiters, timeout, [this]() { return canRead(); });
+}
+
+void SharedChannel::recordWrite(size_t bytes)
+{
+    header_->framesWritten.fetch_add(1, std::memory_order_relaxed);
+    header_->bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void SharedChannel::recordRead()
+{
+    header_->framesRead.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SharedChannel::recordDrop()
+{
+    header_->drops.fetch_add(1, std::memory_order_relaxed);
+}
+
+ChannelStats SharedChannel::stats() const
+{
+    ChannelStats result;
+    result.framesWritten = header_->framesWritten.load(std::memory_order_relaxed);
+    result.framesRead = header_->framesRead.load(std::memory_order_relaxed);
+    result.bytesWritten = header_->bytesWritten.load(std::memory_order_relaxed);
+    result.drops = header_->drops.load(std::memory_order_relaxed);
+    return result;
+}
+
+size_t SharedChannel::slotSize() const
+{
+    return header_->slotSize;
+}
+
+size_t SharedChannel::slotCount() const
+{
+    return header_->slotCount;
+}
+
+}
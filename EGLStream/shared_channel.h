@@ -0,0 +1,91 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace egl {
+
+// Counters of a channel. They live in shared memory, so producers and
+// consumers update them directly and the broker only reads them.
+struct ChannelStats {
+    uint64_t framesWritten = 0;
+    uint64_t framesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t drops = 0;
+};
+
+// Monotonic time in nanoseconds, the clock of SlotHeader::timestampNs.
+// It is the same in all processes of a host, so timestamps taken by a
+// producer can be compared by a consumer.
+uint64_t nowNs();
+
+struct SlotHeader {
+    uint64_t sequence;
+    uint64_t size;
+    uint64_t timestampNs;
+};
+
+// Shared memory segment of one named channel: statistics block followed by
+// a single-producer single-consumer ring of fixed size frame slots.
+// A channel with zero slots carries statistics only (e.g. when frames
+// themselves travel over an EGLStream).
+// Either side can block until the other makes progress. It sleeps on a futex
+// in the segment, and the other side only makes a system call to wake it
+// while it actually sleeps.
+class SharedChannel {
+public:
+    static constexpr size_t MAX_SLOT_SIZE = size_t(1) << 30;
+    static constexpr size_t MAX_SLOT_COUNT = 64;
+    static constexpr size_t MAX_SEGMENT_SIZE = size_t(4) << 30;
+
+    // True if the segment for the layout stays within the limits above.
+    static bool validLayout(size_t slotSize, size_t slotCount);
+
+    // Creates the segment. The creating side unlinks it on destruction.
+    SharedChannel(const std::string& shmName, size_t slotSize, size_t slotCount);
+    // Maps an existing segment.
+    explicit SharedChannel(const std::string& shmName);
+    ~SharedChannel();
+
+    SharedChannel(const SharedChannel&) = delete;
+    SharedChannel& operator=(const SharedChannel&) = delete;
+
+    // Copies frame into the next free slot. Returns false if the ring is full.
+    bool tryWrite(const void* data, size_t size);
+    // Copies the oldest frame out of the ring. Returns false if it is empty.
+    bool tryRead(void* data, size_t capacity, SlotHeader& header);
+
+    // Block until a slot is free / a frame is available.
+    // Return false if that did not happen within timeout.
+    bool waitWrite(std::chrono::nanoseconds timeout);
+    bool waitRead(std::chrono::nanoseconds timeout);
+
+    // Accounting for frames which do not go through the ring.
+    void recordWrite(size_t bytes);
+    void recordRead();
+    void recordDrop();
+
+    ChannelStats stats() const;
+
+    size_t slotSize() const;
+    size_t slotCount() const;
+    const std::string& name() const { return name_; }
+
+private:
+    struct Header;
+
+    void map(int fd, size_t size);
+    uint8_t* slot(uint64_t index) const;
+    bool canWrite() const;
+    bool canRead() const;
+
+    std::string name_;
+    bool owner_;
+    size_t mappedSize_ = 0;
+    size_t slotStride_ = 0;
+    Header* header_ = nullptr;
+    uint8_t* slots_ = nullptr;
+};
+
+}
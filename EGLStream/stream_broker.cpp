@@ -0,0 +1,440 @@
+#include "stream_broker.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace egl {
+
+namespace {
+
+constexpr size_t MAX_NAME = 64;
+constexpr size_t MAX_CHANNELS = 256;
+// Largest reply is LIST of all channels, SOCK_SEQPACKET cuts off longer ones.
+constexpr size_t MAX_MESSAGE = 2 + MAX_CHANNELS * (MAX_NAME + 1);
+
+// Reads one message, MSG_TRUNC reports its real length, so a message which
+// does not fit into the buffer is detected instead of being cut off.
+ssize_t receive(int fd, std::vector<char>& buffer)
+{
+    buffer.resize(MAX_MESSAGE);
+    auto length = recv(fd, buffer.data(), buffer.size(), MSG_TRUNC);
+    if (length > static_cast<ssize_t>(buffer.size())) {
+        throw Error("Message of " + std::to_string(length) + " bytes is too long");
+    }
+    return length;
+}
+
+sockaddr_un socketAddress(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw Error("Socket path is too long: " + path);
+    }
+    strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+
+bool validName(const std::string& name)
+{
+    if (name.empty() || name.size() > MAX_NAME) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+    });
+}
+
+std::string directoryOf(const std::string& path)
+{
+    auto pos = path.rfind('/');
+    if (pos == std::string::npos) {
+        return ".";
+    }
+    return path.substr(0, pos);
+}
+
+const char* roleName(Role role)
+{
+    return role == Role::producer ? "producer" : "consumer";
+}
+
+}
+
+struct Broker::Channel {
+    std::unique_ptr<SharedChannel> shared;
+    std::string streamSocketPath;
+    int producers = 0;
+    int consumers = 0;
+};
+
+struct Broker::Client {
+    int fd;
+    std::string channel;
+    Role role;
+};
+
+Broker::Broker(const std::string& socketPath)
+    : socketPath_(socketPath)
+{
+    auto addr = socketAddress(socketPath_);
+    listenFd_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listenFd_ == -1) {
+        throw Error("Can not create socket");
+    }
+    unlink(socketPath_.c_str());
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(listenFd_);
+        throw Error(std::string("Can not bind: ") + strerror(errno));
+    }
+    if (listen(listenFd_, 64) == -1) {
+        close(listenFd_);
+        throw Error("Can not listen");
+    }
+    if (pipe(wakeFd_) == -1) {
+        close(listenFd_);
+        throw Error("Can not create pipe");
+    }
+}
+
+Broker::~Broker()
+{
+    for (auto& client : clients_) {
+        close(client->fd);
+    }
+    close(wakeFd_[0]);
+    close(wakeFd_[1]);
+    close(listenFd_);
+    unlink(socketPath_.c_str());
+}
+
+void Broker::stop()
+{
+    char byte = 0;
+    if (write(wakeFd_[1], &byte, 1) == -1) {
+        std::cerr << "Can not wake broker: " << strerror(errno) << std::endl;
+    }
+}
+
+void Broker::run()
+{
+    for (;;) {
+        std::vector<pollfd> fds;
+        fds.push_back({wakeFd_[0], POLLIN, 0});
+        fds.push_back({listenFd_, POLLIN, 0});
+        for (auto& client : clients_) {
+            fds.push_back({client->fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw Error(std::string("Poll failed: ") + strerror(errno));
+        }
+
+        if (fds[0].revents) {
+            return;
+        }
+
+        // Serve existing clients first: accepting modifies clients_.
+        std::vector<Client*> closed;
+        std::vector<char> buffer;
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            Client& client = *clients_[i - 2];
+            std::string response;
+            try {
+                auto readCount = receive(client.fd, buffer);
+                if (readCount == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    continue;
+                }
+                if (readCount <= 0) {
+                    closed.push_back(&client);
+                    continue;
+                }
+                response = handle(client, std::string(buffer.data(), readCount));
+            } catch (const Error& e) {
+                response = std::string("ERR ") + e.what();
+            }
+            if (response.size() > MAX_MESSAGE) {
+                response = "ERR response is too long";
+            }
+            // A client which does not read its replies would block the
+            // broker and with it every channel, so it is dropped instead.
+            if (send(client.fd, response.data(), response.size(), MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    std::cerr << "Dropping client which does not read replies" << std::endl;
+                }
+                closed.push_back(&client);
+            }
+        }
+        for (auto* client : closed) {
+            detach(*client);
+            close(client->fd);
+            clients_.erase(std::find_if(clients_.begin(), clients_.end(),
+                [client](const std::unique_ptr<Client>& c) { return c.get() == client; }));
+        }
+
+        if (fds[1].revents) {
+            int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                std::cerr << "Can not accept connection: " << strerror(errno) << std::endl;
+            } else {
+                clients_.push_back(std::unique_ptr<Client>(new Client{fd, "", Role::producer}));
+            }
+        }
+    }
+}
+
+std::string Broker::handle(Client& client, const std::string& request)
+{
+    std::istringstream in(request);
+    std::string command;
+    std::string name;
+    in >> command;
+
+    try {
+        if (command == "ATTACH") {
+            std::string role;
+            size_t slotSize = 0;
+            size_t slotCount = 0;
+            if (!(in >> name >> role >> slotSize >> slotCount)
+                    || (role != "producer" && role != "consumer")) {
+                return "ERR malformed ATTACH";
+            }
+            return attach(client, name, role == "producer" ? Role::producer : Role::consumer, slotSize, slotCount);
+        }
+        if (command == "QUERY") {
+            in >> name;
+            auto it = channels_.find(name);
+            if (it == channels_.end()) {
+                return "ERR unknown channel " + name;
+            }
+            auto channel = info(name, *it->second);
+            std::ostringstream out;
+            out << "OK"
+                << " producers=" << channel.producers
+                << " consumers=" << channel.consumers
+                << " slot_size=" << channel.slotSize
+                << " slot_count=" << channel.slotCount
+                << " frames_written=" << channel.stats.framesWritten
+                << " frames_read=" << channel.stats.framesRead
+                << " bytes_written=" << channel.stats.bytesWritten
+                << " drops=" << channel.stats.drops;
+            return out.str();
+        }
+        if (command == "LIST") {
+            std::string result = "OK";
+            for (auto& channel : channels_) {
+                result += " " + channel.first;
+            }
+            return result;
+        }
+    } catch (const Error& e) {
+        return std::string("ERR ") + e.what();
+    }
+    return "ERR unknown command " + command;
+}
+
+std::string Broker::attach(Client& client, const std::string& name, Role role, size_t slotSize, size_t slotCount)
+{
+    if (!client.channel.empty()) {
+        return "ERR connection is already attached to " + client.channel;
+    }
+    if (!validName(name)) {
+        return "ERR invalid channel name " + name;
+    }
+
+    auto it = channels_.find(name);
+    if (it == channels_.end()) {
+        if (channels_.size() >= MAX_CHANNELS) {
+            return "ERR too many channels";
+        }
+        if (!SharedChannel::validLayout(slotSize, slotCount)) {
+            return "ERR slot layout " + std::to_string(slotSize) + "x" + std::to_string(slotCount) + " is too large";
+        }
+        // Clients bind or connect to the stream socket, its path must fit
+        // into sockaddr_un even if the broker socket itself does.
+        auto streamSocketPath = directoryOf(socketPath_) + "/egl-stream-" + name + ".sock";
+        if (streamSocketPath.size() >= sizeof(sockaddr_un::sun_path)) {
+            return "ERR stream socket path " + streamSocketPath + " is too long";
+        }
+        std::unique_ptr<Channel> channel(new Channel);
+        channel->shared.reset(new SharedChannel(
+            "/egl-" + std::to_string(getpid()) + "-" + name, slotSize, slotCount));
+        channel->streamSocketPath = streamSocketPath;
+        it = channels_.emplace(name, std::move(channel)).first;
+        std::cerr << "Channel " << name << " created" << std::endl;
+    }
+
+    Channel& channel = *it->second;
+    if (channel.shared->slotSize() != slotSize || channel.shared->slotCount() != slotCount) {
+        return "ERR channel " + name + " has different slot layout";
+    }
+    int& attached = role == Role::producer ? channel.producers : channel.consumers;
+    if (attached > 0) {
+        return "ERR channel " + name + " already has a " + roleName(role);
+    }
+
+    ++attached;
+    client.channel = name;
+    client.role = role;
+    std::cerr << "Channel " << name << ": " << roleName(role) << " attached" << std::endl;
+    return "OK " + channel.shared->name() + " " + channel.streamSocketPath;
+}
+
+void Broker::detach(Client& client)
+{
+    if (client.channel.empty()) {
+        return;
+    }
+    auto it = channels_.find(client.channel);
+    Channel& channel = *it->second;
+    --(client.role == Role::producer ? channel.producers : channel.consumers);
+    std::cerr << "Channel " << client.channel << ": " << roleName(client.role) << " detached" << std::endl;
+
+    if (channel.producers == 0 && channel.consumers == 0) {
+        std::cerr << "Channel " << client.channel << " destroyed" << std::endl;
+        channels_.erase(it);
+    }
+    client.channel.clear();
+}
+
+ChannelInfo Broker::info(const std::string& name, const Channel& channel) const
+{
+    ChannelInfo result;
+    result.name = name;
+    result.producers = channel.producers;
+    result.consumers = channel.consumers;
+    result.slotSize = channel.shared->slotSize();
+    result.slotCount = channel.shared->slotCount();
+    result.stats = channel.shared->stats();
+    return result;
+}
+
+
+BrokerClient::BrokerClient(const std::string& socketPath)
+{
+    auto addr = socketAddress(socketPath);
+    fd_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd_ == -1) {
+        throw Error("Can not create socket");
+    }
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(fd_);
+        throw Error(std::string("Can not connect to broker: ") + strerror(errno));
+    }
+}
+
+BrokerClient::~BrokerClient()
+{
+    close(fd_);
+}
+
+std::string BrokerClient::request(const std::string& message)
+{
+    if (send(fd_, message.data(), message.size(), MSG_NOSIGNAL) == -1) {
+        throw Error(std::string("Can not write to broker: ") + strerror(errno));
+    }
+    std::vector<char> buffer;
+    auto readCount = receive(fd_, buffer);
+    if (readCount <= 0) {
+        throw Error("Broker closed connection");
+    }
+    std::string response(buffer.data(), readCount);
+    if (response.compare(0, 2, "OK") == 0 && (response.size() == 2 || response[2] == ' ')) {
+        return response.size() > 3 ? response.substr(3) : "";
+    }
+    if (response.compare(0, 4, "ERR ") == 0) {
+        throw Error(response.substr(4));
+    }
+    throw Error("Malformed broker response: " + response);
+}
+
+BrokerClient::Attachment BrokerClient::attach(const std::string& channel, Role role, size_t slotSize, size_t slotCount)
+{
+    std::ostringstream message;
+    message << "ATTACH " << channel << " " << roleName(role) << " " << slotSize << " " << slotCount;
+    std::istringstream response(request(message.str()));
+
+    Attachment result;
+    if (!(response >> result.shmName >> result.streamSocketPath)) {
+        throw Error("Malformed ATTACH response");
+    }
+    return result;
+}
+
+ChannelInfo BrokerClient::query(const std::string& channel)
+{
+    std::istringstream response(request("QUERY " + channel));
+
+    ChannelInfo result;
+    result.name = channel;
+    std::string field;
+    while (response >> field) {
+        auto pos = field.find('=');
+        if (pos == std::string::npos) {
+            throw Error("Malformed QUERY response");
+        }
+        auto key = field.substr(0, pos);
+        auto value = std::stoull(field.substr(pos + 1));
+        if (key == "producers") {
+            result.producers = value;
+        } else if (key == "consumers") {
+            result.consumers = value;
+        } else if (key == "slot_size") {
+            result.slotSize = value;
+        } else if (key == "slot_count") {
+            result.slotCount = value;
+        } else if (key == "frames_written") {
+            result.stats.framesWritten = value;
+        } else if (key == "frames_read") {
+            result.stats.framesRead = value;
+        } else if (key == "bytes_written") {
+            result.stats.bytesWritten = value;
+        } else if (key == "drops") {
+            result.stats.drops = value;
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> BrokerClient::list()
+{
+    std::istringstream response(request("LIST"));
+    std::vector<std::string> result;
+    std::string name;
+    while (response >> name) {
+        result.push_back(name);
+    }
+    return result;
+}
+
+StreamEndpoint attachStream(const std::string& channel, Role role, const std::string& brokerSocket)
+{
+    StreamEndpoint result;
+    if (channel.empty()) {
+        return result;
+    }
+    result.broker.reset(new BrokerClient(brokerSocket));
+    auto attachment = result.broker->attach(channel, role);
+    result.socketPath = attachment.streamSocketPath;
+    result.channel.reset(new SharedChannel(attachment.shmName));
+    return result;
+}
+
+}
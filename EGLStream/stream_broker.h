@@ -0,0 +1,106 @@
+#pragma once
+#include "EGLStream/shared_channel.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace egl {
+
+const std::string DEFAULT_BROKER_SOCKET = "/tmp/egl-broker.sock";
+// EGLStream socket used without a broker.
+const std::string DEFAULT_STREAM_SOCKET = "/tmp/egl-stream.sock";
+
+enum class Role {
+    producer,
+    consumer
+};
+
+struct ChannelInfo {
+    std::string name;
+    int producers = 0;
+    int consumers = 0;
+    size_t slotSize = 0;
+    size_t slotCount = 0;
+    ChannelStats stats;
+};
+
+// Registry of named channels. Producers and consumers connect to the broker
+// socket and attach to a channel by name; the broker creates the channel's
+// shared memory on first attach and destroys it when the last client leaves.
+//
+// Requests are single text messages over SOCK_SEQPACKET:
+//   ATTACH <name> producer|consumer <slotSize> <slotCount>
+//       -> OK <shmName> <streamSocketPath>
+//   QUERY <name>
+//       -> OK producers=.. consumers=.. slot_size=.. slot_count=..
+//             frames_written=.. frames_read=.. bytes_written=.. drops=..
+//   LIST
+//       -> OK [<name> ...]
+// Errors are reported as "ERR <message>". A connection holds at most one
+// attachment, which is released when the connection is closed.
+class Broker {
+public:
+    explicit Broker(const std::string& socketPath = DEFAULT_BROKER_SOCKET);
+    ~Broker();
+
+    // Serves requests until stop() is called from another thread.
+    void run();
+    void stop();
+
+private:
+    struct Channel;
+    struct Client;
+
+    std::string handle(Client& client, const std::string& request);
+    std::string attach(Client& client, const std::string& name, Role role, size_t slotSize, size_t slotCount);
+    void detach(Client& client);
+    ChannelInfo info(const std::string& name, const Channel& channel) const;
+
+    const std::string socketPath_;
+    int listenFd_;
+    int wakeFd_[2];
+    std::map<std::string, std::unique_ptr<Channel>> channels_;
+    std::vector<std::unique_ptr<Client>> clients_;
+};
+
+class BrokerClient {
+public:
+    struct Attachment {
+        std::string shmName;
+        std::string streamSocketPath;
+    };
+
+    explicit BrokerClient(const std::string& socketPath = DEFAULT_BROKER_SOCKET);
+    ~BrokerClient();
+
+    BrokerClient(const BrokerClient&) = delete;
+    BrokerClient& operator=(const BrokerClient&) = delete;
+
+    // Zero slotCount attaches to a statistics-only channel.
+    Attachment attach(const std::string& channel, Role role, size_t slotSize = 0, size_t slotCount = 0);
+    ChannelInfo query(const std::string& channel);
+    std::vector<std::string> list();
+
+private:
+    std::string request(const std::string& message);
+
+    int fd_;
+};
+
+// EGLStream endpoint of a producer or consumer. With a channel name the
+// stream socket is handed out by the broker, which also keeps statistics of
+// the channel; the attachment lasts as long as the endpoint. Without one
+// the fixed DEFAULT_STREAM_SOCKET is used and channel is null.
+struct StreamEndpoint {
+    std::string socketPath = DEFAULT_STREAM_SOCKET;
+    std::unique_ptr<BrokerClient> broker;
+    std::unique_ptr<SharedChannel> channel;
+};
+
+StreamEndpoint attachStream(const std::string& channel, Role role,
+    const std::string& brokerSocket = DEFAULT_BROKER_SOCKET);
+
+}
@@ -0,0 +1,245 @@
+#include <gmock/gmock.h>
+
+#include "EGLStream/error.h"
+#include "EGLStream/stream_broker.h"
+
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const std::string SOCKET_PATH = "/tmp/egl-broker-test.sock";
+
+class BrokerTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        broker_.reset(new egl::Broker(SOCKET_PATH));
+        thread_ = std::thread([this]() { broker_->run(); });
+    }
+
+    void TearDown() override
+    {
+        broker_->stop();
+        thread_.join();
+    }
+
+    std::unique_ptr<egl::Broker> broker_;
+    std::thread thread_;
+};
+
+}
+
+TEST(SharedChannelTest, passesFramesInOrder)
+{
+    egl::SharedChannel writer("/egl-test-channel", 16, 2);
+    egl::SharedChannel reader("/egl-test-channel");
+
+    int frame = 1;
+    ASSERT_TRUE(writer.tryWrite(&frame, sizeof(frame)));
+    frame = 2;
+    ASSERT_TRUE(writer.tryWrite(&frame, sizeof(frame)));
+    ASSERT_FALSE(writer.tryWrite(&frame, sizeof(frame)));
+
+    egl::SlotHeader header;
+    int received = 0;
+    ASSERT_TRUE(reader.tryRead(&received, sizeof(received), header));
+    EXPECT_EQ(1, received);
+    EXPECT_EQ(0u, header.sequence);
+    ASSERT_TRUE(reader.tryRead(&received, sizeof(received), header));
+    EXPECT_EQ(2, received);
+    EXPECT_EQ(1u, header.sequence);
+    ASSERT_FALSE(reader.tryRead(&received, sizeof(received), header));
+
+    auto stats = writer.stats();
+    EXPECT_EQ(2u, stats.framesWritten);
+    EXPECT_EQ(2u, stats.framesRead);
+    EXPECT_EQ(2 * sizeof(int), stats.bytesWritten);
+}
+
+TEST(SharedChannelTest, waitsForPeer)
+{
+    using namespace std::chrono_literals;
+    egl::SharedChannel writer("/egl-test-channel", 16, 1);
+    egl::SharedChannel reader("/egl-test-channel");
+
+    EXPECT_FALSE(reader.waitRead(10ms));
+    EXPECT_TRUE(writer.waitWrite(0ms));
+
+    int frame = 1;
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(20ms);
+        writer.tryWrite(&frame, sizeof(frame));
+    });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(reader.waitRead(5s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    producer.join();
+
+    EXPECT_FALSE(writer.waitWrite(10ms));
+    std::thread consumer([&]() {
+        std::this_thread::sleep_for(20ms);
+        egl::SlotHeader header;
+        int received = 0;
+        reader.tryRead(&received, sizeof(received), header);
+    });
+    start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(writer.waitWrite(5s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    consumer.join();
+}
+
+TEST_F(BrokerTest, attachesProducerAndConsumerByName)
+{
+    egl::BrokerClient producer(SOCKET_PATH);
+    egl::BrokerClient consumer(SOCKET_PATH);
+
+    auto p = producer.attach("cam0", egl::Role::producer, 64, 4);
+    auto c = consumer.attach("cam0", egl::Role::consumer, 64, 4);
+    EXPECT_EQ(p.shmName, c.shmName);
+    EXPECT_EQ("/tmp/egl-stream-cam0.sock", p.streamSocketPath);
+
+    egl::SharedChannel out(p.shmName);
+    egl::SharedChannel in(c.shmName);
+    char frame[64] = "frame";
+    ASSERT_TRUE(out.tryWrite(frame, sizeof(frame)));
+    egl::SlotHeader header;
+    char received[64];
+    ASSERT_TRUE(in.tryRead(received, sizeof(received), header));
+    EXPECT_STREQ("frame", received);
+
+    egl::BrokerClient monitor(SOCKET_PATH);
+    auto info = monitor.query("cam0");
+    EXPECT_EQ(1, info.producers);
+    EXPECT_EQ(1, info.consumers);
+    EXPECT_EQ(1u, info.stats.framesWritten);
+    EXPECT_EQ(1u, info.stats.framesRead);
+    EXPECT_EQ(64u, info.stats.bytesWritten);
+    EXPECT_THAT(monitor.list(), ::testing::ElementsAre("cam0"));
+}
+
+TEST_F(BrokerTest, attachesStreamEndpoint)
+{
+    auto standalone = egl::attachStream("", egl::Role::producer, SOCKET_PATH);
+    EXPECT_EQ(egl::DEFAULT_STREAM_SOCKET, standalone.socketPath);
+    EXPECT_FALSE(standalone.channel);
+
+    auto endpoint = egl::attachStream("cam0", egl::Role::consumer, SOCKET_PATH);
+    EXPECT_EQ("/tmp/egl-stream-cam0.sock", endpoint.socketPath);
+    ASSERT_TRUE(endpoint.channel);
+    endpoint.channel->recordRead();
+
+    egl::BrokerClient monitor(SOCKET_PATH);
+    auto info = monitor.query("cam0");
+    EXPECT_EQ(1, info.consumers);
+    EXPECT_EQ(1u, info.stats.framesRead);
+}
+
+TEST_F(BrokerTest, rejectsSecondProducer)
+{
+    egl::BrokerClient first(SOCKET_PATH);
+    egl::BrokerClient second(SOCKET_PATH);
+
+    first.attach("cam0", egl::Role::producer);
+    EXPECT_THROW(second.attach("cam0", egl::Role::producer), egl::Error);
+    EXPECT_THROW(second.attach("cam0", egl::Role::consumer, 64, 4), egl::Error);
+    EXPECT_THROW(second.attach("../cam", egl::Role::consumer), egl::Error);
+}
+
+TEST_F(BrokerTest, destroysChannelWhenLastClientLeaves)
+{
+    egl::BrokerClient monitor(SOCKET_PATH);
+    {
+        egl::BrokerClient producer(SOCKET_PATH);
+        producer.attach("cam0", egl::Role::producer);
+    }
+    // Broker notices closed connection asynchronously.
+    for (int i = 0; i < 100 && !monitor.list().empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(monitor.list().empty());
+    EXPECT_THROW(monitor.query("cam0"), egl::Error);
+}
+
+TEST_F(BrokerTest, listsManyChannelsWithLongNames)
+{
+    std::vector<std::unique_ptr<egl::BrokerClient>> producers;
+    std::vector<std::string> names;
+    for (int i = 0; i < 64; ++i) {
+        auto name = std::to_string(100 + i) + std::string(61, 'c');
+        producers.emplace_back(new egl::BrokerClient(SOCKET_PATH));
+        producers.back()->attach(name, egl::Role::producer);
+        names.push_back(name);
+    }
+
+    egl::BrokerClient monitor(SOCKET_PATH);
+    EXPECT_EQ(names, monitor.list());
+}
+
+TEST_F(BrokerTest, rejectsOversizedSlotLayout)
+{
+    egl::BrokerClient client(SOCKET_PATH);
+    EXPECT_THROW(client.attach("cam0", egl::Role::producer, SIZE_MAX - 8, 2), egl::Error);
+    EXPECT_THROW(client.attach("cam0", egl::Role::producer, 1 << 20, SIZE_MAX / 2), egl::Error);
+    EXPECT_THROW(client.attach("cam0", egl::Role::producer, 1 << 30, 64), egl::Error);
+    EXPECT_TRUE(client.list().empty());
+}
+
+TEST_F(BrokerTest, dropsClientWhichDoesNotReadReplies)
+{
+    egl::BrokerClient producer(SOCKET_PATH);
+    producer.attach("cam0", egl::Role::producer);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ASSERT_NE(-1, fd);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH.c_str());
+    ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    // Replies are never read, so the broker eventually can not send one
+    // and must close the connection rather than block on it.
+    const std::string request = "QUERY cam0";
+    bool dropped = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!dropped && std::chrono::steady_clock::now() < deadline) {
+        if (send(fd, request.data(), request.size(), MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } else {
+                dropped = true;
+            }
+        }
+    }
+    EXPECT_TRUE(dropped);
+    close(fd);
+
+    egl::BrokerClient monitor(SOCKET_PATH);
+    EXPECT_THAT(monitor.list(), ::testing::ElementsAre("cam0"));
+}
+
+TEST(BrokerPathTest, rejectsStreamSocketPathTooLongForSockaddr)
+{
+    // Broker socket fits into sockaddr_un, stream sockets next to it may not.
+    const std::string directory = "/tmp/egl-broker-test-" + std::string(60, 'd');
+    const std::string socketPath = directory + "/broker.sock";
+    mkdir(directory.c_str(), 0700);
+    {
+        egl::Broker broker(socketPath);
+        std::thread thread([&broker]() { broker.run(); });
+
+        egl::BrokerClient client(socketPath);
+        EXPECT_THROW(client.attach(std::string(64, 'c'), egl::Role::producer), egl::Error);
+        EXPECT_TRUE(client.list().empty());
+        auto attachment = client.attach("cam0", egl::Role::producer);
+        EXPECT_EQ(directory + "/egl-stream-cam0.sock", attachment.streamSocketPath);
+
+        broker.stop();
+        thread.join();
+    }
+    rmdir(directory.c_str());
+}
@@ -0,0 +1,107 @@
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "camera_calibration/multi_camera.h"
+
+// Rig calibration time against the number of cameras, sequential and
+// parallel. Views are synthetic: a board in random poses in front of a row
+// of cameras, projected with known intrinsics plus pixel noise.
+//
+// Usage: calibration_benchmark [views] [max cameras]
+
+namespace {
+
+const cv::Size IMAGE_SIZE{1280, 720};
+const double BASELINE = 100;
+
+std::vector<calib::ViewSet> synthesizeViews(size_t cameras, size_t count, cv::RNG& rng)
+{
+    cv::Matx33d cameraMatrix(
+        900, 0, IMAGE_SIZE.width / 2.,
+        0, 900, IMAGE_SIZE.height / 2.,
+        0, 0, 1);
+    cv::Mat distCoeff = (cv::Mat_<double>(5, 1) << -0.1, 0.02, 0, 0, 0);
+    auto corners = calib::boardCorners(calib::BOARD_SIZE, calib::SQUARE_SIZE);
+    cv::Point3d boardCenter(
+        (calib::BOARD_SIZE.width - 1) * calib::SQUARE_SIZE / 2.,
+        (calib::BOARD_SIZE.height - 1) * calib::SQUARE_SIZE / 2., 0);
+
+    std::vector<calib::ViewSet> views;
+    while (views.size() < count) {
+        cv::Vec3d rvec(rng.uniform(-0.5, 0.5), rng.uniform(-0.5, 0.5), rng.uniform(-0.3, 0.3));
+        cv::Matx33d rotation;
+        cv::Rodrigues(rvec, rotation);
+        cv::Vec3d position(
+            rng.uniform(-100., 100. + BASELINE * (cameras - 1)),
+            rng.uniform(-80., 80.),
+            rng.uniform(500., 900.));
+
+        std::vector<cv::Point3f> world;
+        for (const auto& corner : corners) {
+            cv::Vec3d local(corner.x - boardCenter.x, corner.y - boardCenter.y, corner.z);
+            cv::Vec3d p = rotation * local + position;
+            world.push_back(cv::Point3f(p[0], p[1], p[2]));
+        }
+
+        calib::ViewSet view;
+        for (size_t i = 0; i < cameras; ++i) {
+            std::vector<cv::Point2f> image;
+            cv::projectPoints(world, cv::Vec3d(0, 0, 0), cv::Vec3d(-BASELINE * i, 0, 0),
+                cameraMatrix, distCoeff, image);
+            cv::Rect2f frame(0, 0, IMAGE_SIZE.width, IMAGE_SIZE.height);
+            bool inside = true;
+            for (auto& point : image) {
+                point.x += rng.gaussian(0.2);
+                point.y += rng.gaussian(0.2);
+                inside = inside && frame.contains(point);
+            }
+            view.found.push_back(inside);
+            view.corners.push_back(inside ? image : std::vector<cv::Point2f>());
+        }
+        if (calib::visibleInAnyPair(view, calib::adjacentPairs(cameras))) {
+            views.push_back(view);
+        }
+    }
+    return views;
+}
+
+double timeCalibration(const std::vector<calib::ViewSet>& views, size_t cameras, bool parallel)
+{
+    auto start = std::chrono::steady_clock::now();
+    calib::calibrateRig(views, calib::adjacentPairs(cameras),
+        calib::boardCorners(calib::BOARD_SIZE, calib::SQUARE_SIZE),
+        std::vector<cv::Size>(cameras, IMAGE_SIZE), parallel);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t viewCount = argc > 1 ? atol(argv[1]) : 40;
+    size_t maxCameras = argc > 2 ? atol(argv[2]) : 6;
+    cv::RNG rng(42);
+
+    std::cout << viewCount << " views" << std::endl
+        << std::setw(8) << "cameras"
+        << std::setw(14) << "sequential s"
+        << std::setw(12) << "parallel s"
+        << std::setw(10) << "speedup" << std::endl;
+    for (size_t cameras = 1; cameras <= maxCameras; ++cameras) {
+        auto views = synthesizeViews(cameras, viewCount, rng);
+        double sequential = timeCalibration(views, cameras, false);
+        double parallel = timeCalibration(views, cameras, true);
+        std::cout << std::setw(8) << cameras
+            << std::fixed << std::setprecision(3)
+            << std::setw(14) << sequential
+            << std::setw(12) << parallel
+            << std::setw(10) << std::setprecision(2) << sequential / parallel << std::endl;
+    }
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/highgui.hpp>
@@ -6,39 +7,178 @@
 
 #include <chrono>
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "camera_calibration/multi_camera.h"
+#include "realtime/realtime.h"
 
 using namespace std::chrono_literals;
 
 namespace {
-cv::Size boardSize{7, 5};
 int chessBoardFlags = cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE;
 
-const float SQUARE_SIZE = 28;
-
 const size_t PATTERNS = 20;
 
-std::vector<cv::Point3f> calcCornersPositions()
+// Frames of different cameras closer than this are taken as simultaneous.
+const auto SYNC_TOLERANCE = 15ms;
+
+std::chrono::steady_clock::time_point now() {
+    return std::chrono::steady_clock::now();
+}
+
+// OpenCV starts its thread pool on first use. Starting it before the
+// frame loop is pinned keeps the pool threads off the frame loop core.
+void startOpenCvWorkers() {
+    cv::parallel_for_(cv::Range(0, cv::getNumThreads()), [](const cv::Range&) {});
+}
+
+int parseSource(const std::string& arg)
 {
-    std::vector<cv::Point3f> result;
-    for (int i = 0; i < boardSize.height; ++i) {
-        for (int j = 0; j < boardSize.width; ++j) {
-            result.push_back(
-                cv::Point3f(j * SQUARE_SIZE, i * SQUARE_SIZE, 0)
-            );
-        }
+    size_t parsed = 0;
+    int source = -1;
+    try {
+        source = std::stoi(arg, &parsed);
+    } catch (const std::logic_error&) {
+    }
+    if (source < 0 || parsed != arg.size()) {
+        throw std::invalid_argument("Invalid camera index: " + arg);
     }
-    return result;
+    return source;
 }
 
-std::chrono::steady_clock::time_point now() {
-    return std::chrono::steady_clock::now();
+double seconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+// Captures all cameras in parallel, keeps views where the board is seen by
+// both cameras of some neighbouring pair, then calibrates intrinsics of
+// every camera and extrinsics of every pair concurrently.
+// Capture threads are the real-time stages; this thread stays unpinned, so
+// detection and calibration tasks it starts spread over the other cores.
+int calibrateMultiCamera(const std::vector<int>& sources, const rt::Config& rtConfig)
+{
+    auto start = now();
+    std::unique_ptr<calib::MultiCapture> capture;
+    try {
+        capture.reset(new calib::MultiCapture(sources, rtConfig, SYNC_TOLERANCE));
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    auto pairs = calib::adjacentPairs(sources.size());
+
+    // Capture threads are the real-time stages, so their frame intervals
+    // are reported on every exit.
+    auto finishCapture = [&]() {
+        capture->stop();
+        for (size_t i = 0; i < capture->size(); ++i) {
+            capture->intervals(i).print(std::cout, "Camera " + std::to_string(i) + " frame intervals");
+        }
+    };
+
+    auto enoughViews = [&](const std::vector<calib::ViewSet>& views) {
+        if (pairs.empty()) {
+            return views.size() >= PATTERNS;
+        }
+        for (const auto& pair : pairs) {
+            if (calib::commonViews(views, pair) < PATTERNS) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<calib::ViewSet> views;
+    std::vector<cv::Mat> frames;
+    auto prevView = now();
+    while (!enoughViews(views)) {
+        if (!capture->next(frames, 1s)) {
+            if (capture->stopped()) {
+                std::cerr << "Camera stopped before enough views were captured" << std::endl;
+                finishCapture();
+                return 1;
+            }
+            std::cerr << "No synchronized frames, waiting" << std::endl;
+            if (cv::waitKey(1) == 27) {
+                finishCapture();
+                return 0;
+            }
+            continue;
+        }
+        auto view = calib::detectBoard(frames, calib::BOARD_SIZE, chessBoardFlags);
+        if (calib::visibleInAnyPair(view, pairs) && now() - prevView > 500ms) {
+            views.push_back(view);
+            prevView = now();
+            std::cout << "Captured view: " << views.size() << std::endl;
+        }
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (view.found[i]) {
+                cv::drawChessboardCorners(frames[i], calib::BOARD_SIZE, cv::Mat(view.corners[i]), true);
+            }
+            cv::imshow("Camera " + std::to_string(i), frames[i]);
+        }
+        if (cv::waitKey(1) == 27) {
+            finishCapture();
+            return 0;
+        }
+    }
+    finishCapture();
+    auto captured = now();
+
+    auto rig = calib::calibrateRig(views, pairs,
+        calib::boardCorners(calib::BOARD_SIZE, calib::SQUARE_SIZE), capture->imageSizes());
+    auto calibrated = now();
+
+    for (size_t i = 0; i < rig.cameras.size(); ++i) {
+        const auto& camera = rig.cameras[i];
+        std::cout << "Camera " << i << ": error " << camera.rms << " on " << camera.views << " views" << std::endl
+            << "Camera matrix:" << std::endl << camera.cameraMatrix << std::endl
+            << "Distortion:" << std::endl << camera.distCoeff.t() << std::endl;
+    }
+    for (const auto& pair : rig.pairs) {
+        std::cout << "Cameras " << pair.cameras.first << "-" << pair.cameras.second
+            << ": error " << pair.rms << " on " << pair.views << " views" << std::endl
+            << "R:" << std::endl << pair.R << std::endl
+            << "T:" << std::endl << pair.T.t() << std::endl;
+    }
+    std::cout << sources.size() << " cameras: capture " << seconds(captured - start)
+        << " s, calibration " << seconds(calibrated - captured)
+        << " s, total " << seconds(calibrated - start) << " s" << std::endl;
+    return 0;
 }
 
 }
 
 int main(int argc, char** argv)
 {
+    // camera_calibration <source> [<source> ...] calibrates a multi-camera rig.
+    rt::Config rtConfig;
+    std::vector<int> sources;
+    try {
+        rtConfig = rt::parseArgs(argc, argv);
+        for (int i = 1; i < argc; ++i) {
+            sources.push_back(parseSource(argv[i]));
+        }
+        // Single camera mode has one stage, the frame loop; a rig has one
+        // capture stage per camera.
+        rt::checkStages(rtConfig, std::max<size_t>(sources.size(), 1));
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl
+            << "Usage: " << argv[0] << " " << rt::USAGE << " [<camera index> ...]" << std::endl;
+        return 1;
+    }
+    rt::enterProcess(rtConfig);
+    startOpenCvWorkers();
+
+    if (!sources.empty()) {
+        return calibrateMultiCamera(sources, rtConfig);
+    }
 
     cv::VideoCapture camera(0);
     cv::namedWindow("Display image");
@@ -52,9 +192,18 @@ int main(int argc, char** argv)
     cv::Mat cameraFrame;
     camera >> cameraFrame;
     cv::Size imageSize = cameraFrame.size();
+    rt::FrameIntervals intervals;
 
     bool showUndistored = true;
 
+    // Frame loop buffers are reused, so after the first frames the loop
+    // no longer allocates.
+    std::vector<cv::Point2f> pointBuf;
+    cv::cuda::GpuMat gpuDisplayFrame;
+    cv::cuda::GpuMat undistorted;
+
+    rt::enterStage(rtConfig, 0);
+
     auto prevFrame = now();
     for (;;) {
         cv::initUndistortRectifyMap(
@@ -65,16 +214,15 @@ int main(int argc, char** argv)
         cv::cuda::GpuMat xmap(map1);
         cv::cuda::GpuMat ymap(map2);
         for (;;) {
-            cv::Mat cameraFrame;
             camera >> cameraFrame;
-            std::vector<cv::Point2f> pointBuf;
-            bool found = cv::findChessboardCorners(cameraFrame, boardSize, pointBuf, chessBoardFlags);
+            intervals.tick();
+            bool found = cv::findChessboardCorners(cameraFrame, calib::BOARD_SIZE, pointBuf, chessBoardFlags);
 
             auto displayFrame = cameraFrame;
 
             if (found) {
                 cv::drawChessboardCorners(
-                    displayFrame, boardSize, cv::Mat(pointBuf), found
+                    displayFrame, calib::BOARD_SIZE, cv::Mat(pointBuf), found
                 );
 
                 if (now() - prevFrame > 500ms) {
@@ -86,15 +234,14 @@ int main(int argc, char** argv)
                     }
                 }
             }
-            cv::cuda::GpuMat gpuDisplayFrame(displayFrame);
+            gpuDisplayFrame.upload(displayFrame);
             if (showUndistored) {
-                cv::cuda::GpuMat temp;
-                cv::remap(gpuDisplayFrame, temp, map1, map2, cv::INTER_LINEAR);
-                gpuDisplayFrame = temp;
+                cv::remap(gpuDisplayFrame, undistorted, map1, map2, cv::INTER_LINEAR);
             }
-            cv::imshow("Display image", gpuDisplayFrame);
+            cv::imshow("Display image", showUndistored ? undistorted : gpuDisplayFrame);
             int key = cv::waitKey(30);
             if (key == 27) {
+                intervals.histogram().print(std::cout, "Frame intervals");
                 return 0;
             }
             if (key != -1) {
@@ -108,7 +255,7 @@ int main(int argc, char** argv)
 
         
         std::vector<std::vector<cv::Point3f>> objectPoints(
-            imagePoints.size(), calcCornersPositions());
+            imagePoints.size(), calib::boardCorners(calib::BOARD_SIZE, calib::SQUARE_SIZE));
 
         std::vector<cv::Mat> rvecs;
         std::vector<cv::Mat> tvecs;
@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace calib {
+
+// Matches frames of several free running sources by capture timestamp.
+// Sources push frames from their own threads; pop() returns one frame per
+// source, all captured within the tolerance of each other.
+template<class Frame>
+class FrameSynchronizer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameSynchronizer(size_t sources, Clock::duration tolerance, size_t history = 4)
+        : tolerance_(tolerance)
+        , history_(history)
+        , queues_(sources)
+    {}
+
+    void push(size_t source, Clock::time_point timestamp, Frame frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& queue = queues_[source];
+            // A stalled source must not make the others pile up frames.
+            if (queue.size() == history_) {
+                queue.pop_front();
+            }
+            queue.emplace_back(timestamp, std::move(frame));
+        }
+        ready_.notify_one();
+    }
+
+    // Returns false on timeout or when the synchronizer is closed.
+    bool pop(std::vector<Frame>& frames, Clock::duration timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool matched = ready_.wait_for(lock, timeout, [&]() {
+            return closed_ || match();
+        });
+        if (!matched || closed_) {
+            return false;
+        }
+        frames.clear();
+        for (auto& queue : queues_) {
+            frames.push_back(std::move(queue.front().second));
+            queue.pop_front();
+        }
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    // Drops frames which can not be matched any more. True if the heads
+    // of all queues form a set.
+    bool match()
+    {
+        for (;;) {
+            Clock::time_point newest = Clock::time_point::min();
+            for (auto& queue : queues_) {
+                if (queue.empty()) {
+                    return false;
+                }
+                newest = std::max(newest, queue.front().first);
+            }
+
+            bool dropped = false;
+            for (auto& queue : queues_) {
+                while (!queue.empty() && queue.front().first + tolerance_ < newest) {
+                    queue.pop_front();
+                    dropped = true;
+                }
+            }
+            if (!dropped) {
+                return true;
+            }
+        }
+    }
+
+    const Clock::duration tolerance_;
+    const size_t history_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::vector<std::deque<std::pair<Clock::time_point, Frame>>> queues_;
+    bool closed_ = false;
+};
+
+}
@@ -0,0 +1,77 @@
+#include <gmock/gmock.h>
+
+#include "camera_calibration/frame_sync.h"
+
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using Sync = calib::FrameSynchronizer<int>;
+
+Sync::Clock::time_point at(std::chrono::milliseconds offset)
+{
+    static const auto start = Sync::Clock::now();
+    return start + offset;
+}
+
+}
+
+TEST(FrameSynchronizerTest, matchesFramesWithinTolerance)
+{
+    Sync sync(2, 5ms);
+    sync.push(0, at(0ms), 1);
+    sync.push(0, at(33ms), 2);
+    sync.push(1, at(31ms), 20);
+
+    std::vector<int> frames;
+    ASSERT_TRUE(sync.pop(frames, 0ms));
+    EXPECT_THAT(frames, ::testing::ElementsAre(2, 20));
+    EXPECT_FALSE(sync.pop(frames, 0ms));
+}
+
+TEST(FrameSynchronizerTest, waitsForLaggingSource)
+{
+    Sync sync(3, 5ms);
+    sync.push(0, at(100ms), 1);
+    sync.push(1, at(102ms), 2);
+
+    std::vector<int> frames;
+    EXPECT_FALSE(sync.pop(frames, 0ms));
+
+    std::thread late([&]() {
+        std::this_thread::sleep_for(10ms);
+        sync.push(2, at(98ms), 3);
+    });
+    EXPECT_TRUE(sync.pop(frames, 1s));
+    late.join();
+    EXPECT_THAT(frames, ::testing::ElementsAre(1, 2, 3));
+}
+
+TEST(FrameSynchronizerTest, boundsHistoryOfStalledSource)
+{
+    Sync sync(2, 1ms, 2);
+    for (int i = 0; i < 10; ++i) {
+        sync.push(0, at(std::chrono::milliseconds(i * 10)), i);
+    }
+    sync.push(1, at(10ms), 100);
+
+    std::vector<int> frames;
+    EXPECT_FALSE(sync.pop(frames, 0ms));
+    sync.push(1, at(90ms), 101);
+    ASSERT_TRUE(sync.pop(frames, 0ms));
+    EXPECT_THAT(frames, ::testing::ElementsAre(9, 101));
+}
+
+TEST(FrameSynchronizerTest, closeWakesWaiter)
+{
+    Sync sync(2, 1ms);
+    std::thread closer([&]() {
+        std::this_thread::sleep_for(10ms);
+        sync.close();
+    });
+    std::vector<int> frames;
+    EXPECT_FALSE(sync.pop(frames, 10s));
+    closer.join();
+}
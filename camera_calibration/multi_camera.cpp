@@ -0,0 +1,263 @@
+#include "multi_camera.h"
+
+#include <opencv2/calib3d.hpp>
+
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace calib {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int CALIBRATION_FLAGS = cv::CALIB_FIX_K4 | cv::CALIB_FIX_K5;
+
+std::launch policy(bool parallel)
+{
+    return parallel ? std::launch::async : std::launch::deferred;
+}
+
+CameraCalibration calibrateCamera(
+    const std::vector<ViewSet>& views, size_t camera,
+    const std::vector<cv::Point3f>& boardCorners, cv::Size imageSize)
+{
+    std::vector<std::vector<cv::Point2f>> imagePoints;
+    for (const auto& view : views) {
+        if (view.found[camera]) {
+            imagePoints.push_back(view.corners[camera]);
+        }
+    }
+    std::vector<std::vector<cv::Point3f>> objectPoints(imagePoints.size(), boardCorners);
+
+    CameraCalibration result;
+    result.cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+    result.distCoeff = cv::Mat::zeros(8, 1, CV_64F);
+    result.views = imagePoints.size();
+    std::vector<cv::Mat> rvecs;
+    std::vector<cv::Mat> tvecs;
+    result.rms = cv::calibrateCamera(
+        objectPoints, imagePoints,
+        imageSize,
+        result.cameraMatrix, result.distCoeff,
+        rvecs, tvecs,
+        CALIBRATION_FLAGS);
+    return result;
+}
+
+PairCalibration calibratePair(
+    const std::vector<ViewSet>& views, const CameraPair& pair,
+    const std::vector<CameraCalibration>& cameras,
+    const std::vector<cv::Point3f>& boardCorners, cv::Size imageSize)
+{
+    std::vector<std::vector<cv::Point2f>> firstPoints;
+    std::vector<std::vector<cv::Point2f>> secondPoints;
+    for (const auto& view : views) {
+        if (view.found[pair.first] && view.found[pair.second]) {
+            firstPoints.push_back(view.corners[pair.first]);
+            secondPoints.push_back(view.corners[pair.second]);
+        }
+    }
+    std::vector<std::vector<cv::Point3f>> objectPoints(firstPoints.size(), boardCorners);
+
+    PairCalibration result;
+    result.cameras = pair;
+    result.views = firstPoints.size();
+    // Intrinsics are calibrated per camera on all of its views,
+    // which are more than the views shared with a neighbour.
+    cv::Mat firstMatrix = cameras[pair.first].cameraMatrix.clone();
+    cv::Mat firstDist = cameras[pair.first].distCoeff.clone();
+    cv::Mat secondMatrix = cameras[pair.second].cameraMatrix.clone();
+    cv::Mat secondDist = cameras[pair.second].distCoeff.clone();
+    cv::Mat E;
+    cv::Mat F;
+    result.rms = cv::stereoCalibrate(
+        objectPoints, firstPoints, secondPoints,
+        firstMatrix, firstDist,
+        secondMatrix, secondDist,
+        imageSize, result.R, result.T, E, F,
+        cv::CALIB_FIX_INTRINSIC);
+    return result;
+}
+
+// V4L2 stamps buffers with the monotonic clock (the one steady_clock uses
+// on Linux) when the driver fills them, and reports it as the position.
+// Other backends report stream position or nothing, which is far from
+// the grab time; then the grab time is used, which is later than capture
+// by the time the frame waited in the driver queue.
+Clock::time_point captureTime(cv::VideoCapture& camera, Clock::time_point grabbed)
+{
+    double ms = camera.get(cv::CAP_PROP_POS_MSEC);
+    Clock::time_point driver(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(ms)));
+    if (ms > 0 && driver <= grabbed && grabbed - driver < std::chrono::seconds(1)) {
+        return driver;
+    }
+    return grabbed;
+}
+
+}
+
+std::vector<cv::Point3f> boardCorners(cv::Size boardSize, float squareSize)
+{
+    std::vector<cv::Point3f> result;
+    for (int i = 0; i < boardSize.height; ++i) {
+        for (int j = 0; j < boardSize.width; ++j) {
+            result.push_back(cv::Point3f(j * squareSize, i * squareSize, 0));
+        }
+    }
+    return result;
+}
+
+std::vector<CameraPair> adjacentPairs(size_t cameras)
+{
+    std::vector<CameraPair> result;
+    for (size_t i = 1; i < cameras; ++i) {
+        result.emplace_back(i - 1, i);
+    }
+    return result;
+}
+
+bool visibleInAnyPair(const ViewSet& view, const std::vector<CameraPair>& pairs)
+{
+    if (pairs.empty()) {
+        return view.found.size() == 1 && view.found[0];
+    }
+    for (const auto& pair : pairs) {
+        if (view.found[pair.first] && view.found[pair.second]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t commonViews(const std::vector<ViewSet>& views, const CameraPair& pair)
+{
+    size_t result = 0;
+    for (const auto& view : views) {
+        if (view.found[pair.first] && view.found[pair.second]) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+ViewSet detectBoard(const std::vector<cv::Mat>& frames, cv::Size boardSize, int flags)
+{
+    ViewSet result;
+    result.found.resize(frames.size());
+    result.corners.resize(frames.size());
+
+    std::vector<std::future<bool>> detections;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        detections.push_back(std::async(std::launch::async, [&, i]() {
+            return cv::findChessboardCorners(frames[i], boardSize, result.corners[i], flags);
+        }));
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+        result.found[i] = detections[i].get();
+    }
+    return result;
+}
+
+RigCalibration calibrateRig(
+    const std::vector<ViewSet>& views,
+    const std::vector<CameraPair>& pairs,
+    const std::vector<cv::Point3f>& boardCorners,
+    const std::vector<cv::Size>& imageSizes,
+    bool parallel)
+{
+    RigCalibration result;
+
+    std::vector<std::future<CameraCalibration>> cameras;
+    for (size_t i = 0; i < imageSizes.size(); ++i) {
+        cameras.push_back(std::async(policy(parallel), [&, i]() {
+            return calibrateCamera(views, i, boardCorners, imageSizes[i]);
+        }));
+    }
+    for (auto& camera : cameras) {
+        result.cameras.push_back(camera.get());
+    }
+
+    // Pairs share intrinsics, but only read them.
+    std::vector<std::future<PairCalibration>> extrinsics;
+    for (const auto& pair : pairs) {
+        extrinsics.push_back(std::async(policy(parallel), [&, pair]() {
+            return calibratePair(views, pair, result.cameras, boardCorners, imageSizes[pair.first]);
+        }));
+    }
+    for (auto& pair : extrinsics) {
+        result.pairs.push_back(pair.get());
+    }
+    return result;
+}
+
+MultiCapture::MultiCapture(const std::vector<int>& sources, const rt::Config& rtConfig,
+        std::chrono::milliseconds tolerance)
+    : cameras_(sources.size())
+    , sync_(sources.size(), tolerance)
+    , intervals_(sources.size())
+{
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!cameras_[i].open(sources[i])) {
+            throw std::runtime_error("Can not open camera " + std::to_string(sources[i]));
+        }
+        cv::Mat frame;
+        cameras_[i] >> frame;
+        if (frame.empty()) {
+            throw std::runtime_error("Camera " + std::to_string(sources[i]) + " delivers no frames");
+        }
+        imageSizes_.push_back(frame.size());
+    }
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+        threads_.emplace_back(&MultiCapture::captureLoop, this, i, rtConfig);
+    }
+}
+
+MultiCapture::~MultiCapture()
+{
+    stop();
+}
+
+void MultiCapture::stop()
+{
+    running_ = false;
+    sync_.close();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+bool MultiCapture::next(std::vector<cv::Mat>& frames, std::chrono::milliseconds timeout)
+{
+    return sync_.pop(frames, timeout);
+}
+
+void MultiCapture::captureLoop(size_t camera, const rt::Config& rtConfig)
+{
+    rt::enterStage(rtConfig, camera);
+    while (running_) {
+        // Timestamp is taken before retrieve(), decoding may take much longer.
+        if (!cameras_[camera].grab()) {
+            break;
+        }
+        intervals_[camera].tick();
+        auto timestamp = captureTime(cameras_[camera], Clock::now());
+        cv::Mat frame;
+        if (!cameras_[camera].retrieve(frame) || frame.empty()) {
+            break;
+        }
+        sync_.push(camera, timestamp, std::move(frame));
+    }
+    if (running_) {
+        std::cerr << "Camera " << camera << " stopped" << std::endl;
+        stopped_ = true;
+        sync_.close();
+    }
+}
+
+}
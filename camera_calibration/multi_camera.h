@@ -0,0 +1,108 @@
+#pragma once
+#include "camera_calibration/frame_sync.h"
+#include "realtime/realtime.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace calib {
+
+using CameraPair = std::pair<size_t, size_t>;
+
+// Chessboard used for calibration: inner corners and square size in mm.
+const cv::Size BOARD_SIZE{7, 5};
+const float SQUARE_SIZE = 28;
+
+// Corner positions on the board plane, row by row.
+std::vector<cv::Point3f> boardCorners(cv::Size boardSize, float squareSize);
+
+// Board corners detected in one synchronized set of frames.
+struct ViewSet {
+    std::vector<bool> found;
+    std::vector<std::vector<cv::Point2f>> corners;
+};
+
+struct CameraCalibration {
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeff;
+    double rms = 0;
+    size_t views = 0;
+};
+
+// Pose of the second camera relative to the first one.
+struct PairCalibration {
+    CameraPair cameras;
+    cv::Mat R;
+    cv::Mat T;
+    double rms = 0;
+    size_t views = 0;
+};
+
+struct RigCalibration {
+    std::vector<CameraCalibration> cameras;
+    std::vector<PairCalibration> pairs;
+};
+
+// Pairs of neighbouring cameras: (0, 1), (1, 2), ...
+std::vector<CameraPair> adjacentPairs(size_t cameras);
+
+bool visibleInAnyPair(const ViewSet& view, const std::vector<CameraPair>& pairs);
+size_t commonViews(const std::vector<ViewSet>& views, const CameraPair& pair);
+
+// Finds the board in every frame of the set, one task per camera.
+// Tasks inherit core and scheduling class of the calling thread, so call
+// it (and calibrateRig) from a thread which is not a real-time stage.
+ViewSet detectBoard(const std::vector<cv::Mat>& frames, cv::Size boardSize, int flags);
+
+// Intrinsics of every camera, then extrinsics of every pair. Cameras and
+// pairs are calibrated concurrently unless parallel is false.
+RigCalibration calibrateRig(
+    const std::vector<ViewSet>& views,
+    const std::vector<CameraPair>& pairs,
+    const std::vector<cv::Point3f>& boardCorners,
+    const std::vector<cv::Size>& imageSizes,
+    bool parallel = true);
+
+// Captures all sources in parallel threads and delivers frame sets matched
+// by capture timestamp. The capture thread of camera N is real-time stage N.
+class MultiCapture {
+public:
+    // Throws std::runtime_error if a camera can not be opened or delivers no frames.
+    MultiCapture(const std::vector<int>& sources, const rt::Config& rtConfig,
+        std::chrono::milliseconds tolerance);
+    ~MultiCapture();
+
+    // Stops and joins capture threads.
+    void stop();
+
+    // Returns false if no matching set arrived within timeout,
+    // or if a camera stopped.
+    bool next(std::vector<cv::Mat>& frames, std::chrono::milliseconds timeout);
+    // True once a camera stopped delivering frames; no more sets will arrive.
+    bool stopped() const { return stopped_; }
+    // Intervals between grabbed frames of the camera, read them after stop().
+    const rt::JitterHistogram& intervals(size_t camera) const { return intervals_[camera].histogram(); }
+
+    const std::vector<cv::Size>& imageSizes() const { return imageSizes_; }
+    size_t size() const { return cameras_.size(); }
+
+private:
+    void captureLoop(size_t camera, const rt::Config& rtConfig);
+
+    std::vector<cv::VideoCapture> cameras_;
+    std::vector<cv::Size> imageSizes_;
+    FrameSynchronizer<cv::Mat> sync_;
+    std::atomic<bool> running_{true};
+    std::atomic<bool> stopped_{false};
+    std::vector<rt::FrameIntervals> intervals_;
+    std::vector<std::thread> threads_;
+};
+
+}
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "realtime/realtime.h"
+
+// Frame pacing jitter with real-time mode off and on, under synthetic CPU
+// and memory stress. A paced loop copies a frame every period and records
+// the intervals between frames.
+//
+// Usage: jitter_benchmark [--rt] [--rt-cpus=..] [--rt-fifo=..]
+//                         [seconds per phase] [stress threads] [period ms]
+// Without real-time options the "on" phase uses --rt --rt-cpus=0 --rt-fifo=50.
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr size_t FRAME_BYTES = 1280 * 720 * 3;
+constexpr size_t STRESS_BYTES = 8 << 20;
+
+void stress(const std::atomic<bool>& running)
+{
+    while (running) {
+        // Fresh allocation every time, so the stress also causes page faults.
+        std::vector<uint8_t> buffer(STRESS_BYTES);
+        for (size_t i = 0; i < buffer.size() && running; i += 64) {
+            buffer[i] = i;
+        }
+    }
+}
+
+rt::JitterHistogram pacedLoop(const rt::Config& config, std::chrono::duration<double> duration,
+        std::chrono::nanoseconds period)
+{
+    rt::enterStage(config, 0);
+
+    std::vector<uint8_t> source(FRAME_BYTES, 1);
+    std::vector<uint8_t> frame(FRAME_BYTES);
+    rt::prefault(config, source.data(), source.size());
+    rt::prefault(config, frame.data(), frame.size());
+
+    rt::FrameIntervals intervals;
+    auto end = std::chrono::steady_clock::now() + duration;
+    auto next = std::chrono::steady_clock::now();
+    while (next < end) {
+        std::this_thread::sleep_until(next);
+        intervals.tick();
+        memcpy(frame.data(), source.data(), frame.size());
+        next += period;
+    }
+    return intervals.histogram();
+}
+
+rt::JitterHistogram runPhase(const rt::Config& config, double seconds, int stressThreads,
+        std::chrono::nanoseconds period)
+{
+    std::atomic<bool> running{true};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < stressThreads; ++i) {
+        threads.emplace_back(stress, std::cref(running));
+    }
+
+    rt::JitterHistogram result;
+    std::thread paced([&]() {
+        result = pacedLoop(config, std::chrono::duration<double>(seconds), period);
+    });
+    paced.join();
+
+    running = false;
+    for (auto& t : threads) {
+        t.join();
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+    rt::Config config;
+    try {
+        config = rt::parseArgs(argc, argv);
+        rt::checkStages(config, 1);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl
+            << "Usage: " << argv[0] << " " << rt::USAGE
+            << " [seconds per phase] [stress threads] [period ms]" << std::endl;
+        return 1;
+    }
+    if (!config.enabled()) {
+        config.lockMemory = true;
+        config.cpus = {0};
+        config.fifoPriority = 50;
+    }
+
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    int stressThreads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+    auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double, std::milli>(argc > 3 ? atof(argv[3]) : 5.0));
+
+    std::cout << stressThreads << " stress threads, period " << period.count() / 1e6 << " ms" << std::endl;
+
+    runPhase(rt::Config(), seconds, stressThreads, period).print(std::cout, "real-time off");
+
+    rt::enterProcess(config);
+    runPhase(config, seconds, stressThreads, period).print(std::cout, "real-time on ");
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "realtime.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rt {
+
+namespace {
+
+const std::string RT_FLAG = "--rt";
+const std::string CPUS_FLAG = "--rt-cpus=";
+const std::string FIFO_FLAG = "--rt-fifo=";
+
+bool startsWith(const std::string& s, const std::string& prefix)
+{
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Whole string must be a number within [min, max].
+bool parseNumber(const std::string& value, int min, int max, int& result)
+{
+    size_t parsed = 0;
+    try {
+        result = std::stoi(value, &parsed);
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    return parsed == value.size() && result >= min && result <= max;
+}
+
+std::invalid_argument invalidOption(const std::string& arg)
+{
+    return std::invalid_argument("Invalid option " + arg);
+}
+
+std::vector<int> parseCpus(const std::string& arg)
+{
+    std::vector<int> result;
+    std::istringstream in(arg.substr(CPUS_FLAG.size()));
+    std::string cpu;
+    while (std::getline(in, cpu, ',')) {
+        int value = 0;
+        if (!parseNumber(cpu, 0, CPU_SETSIZE - 1, value)) {
+            throw invalidOption(arg);
+        }
+        result.push_back(value);
+    }
+    if (result.empty()) {
+        throw invalidOption(arg);
+    }
+    return result;
+}
+
+size_t bucketOf(uint64_t value)
+{
+    constexpr size_t SUB_BITS = 4;
+    if (value < (1u << SUB_BITS)) {
+        return value;
+    }
+    size_t exponent = 63 - __builtin_clzll(value);
+    size_t mantissa = (value >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+    return (exponent - SUB_BITS + 1) * (1u << SUB_BITS) + mantissa;
+}
+
+uint64_t upperBoundOf(size_t bucket)
+{
+    constexpr size_t SUB_BITS = 4;
+    if (bucket < (1u << SUB_BITS)) {
+        return bucket;
+    }
+    size_t exponent = bucket / (1u << SUB_BITS) + SUB_BITS - 1;
+    uint64_t mantissa = bucket % (1u << SUB_BITS);
+    uint64_t lower = (uint64_t(1) << exponent) + (mantissa << (exponent - SUB_BITS));
+    return lower + (uint64_t(1) << (exponent - SUB_BITS)) - 1;
+}
+
+}
+
+Config parseArgs(int& argc, char** argv)
+{
+    Config config;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == RT_FLAG) {
+            config.lockMemory = true;
+        } else if (startsWith(arg, CPUS_FLAG)) {
+            config.cpus = parseCpus(arg);
+        } else if (startsWith(arg, FIFO_FLAG)) {
+            if (!parseNumber(arg.substr(FIFO_FLAG.size()), 0, sched_get_priority_max(SCHED_FIFO),
+                    config.fifoPriority)) {
+                throw invalidOption(arg);
+            }
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = nullptr;
+    return config;
+}
+
+void checkStages(const Config& config, size_t stages)
+{
+    if (config.cpus.size() > stages) {
+        throw std::invalid_argument(std::to_string(config.cpus.size()) + " cores given for "
+            + std::to_string(stages) + (stages == 1 ? " stage" : " stages"));
+    }
+}
+
+void enterProcess(const Config& config)
+{
+    if (config.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        std::cerr << "mlockall failed: " << strerror(errno) << std::endl;
+    }
+}
+
+void enterStage(const Config& config, size_t stage)
+{
+    if (stage < config.cpus.size()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpus[stage], &cpus);
+        int status = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (status != 0) {
+            std::cerr << "Can not pin stage " << stage << ": " << strerror(status) << std::endl;
+        }
+    }
+    if (config.fifoPriority > 0) {
+        sched_param param{};
+        param.sched_priority = config.fifoPriority;
+        int status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (status != 0) {
+            std::cerr << "Can not set SCHED_FIFO for stage " << stage << ": " << strerror(status) << std::endl;
+        }
+    }
+}
+
+void prefault(void* data, size_t size)
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    auto bytes = static_cast<volatile uint8_t*>(data);
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        bytes[offset] = bytes[offset];
+    }
+    if (size > 0) {
+        bytes[size - 1] = bytes[size - 1];
+    }
+}
+
+void prefault(const Config& config, void* data, size_t size)
+{
+    if (config.enabled()) {
+        prefault(data, size);
+    }
+}
+
+void JitterHistogram::record(std::chrono::nanoseconds value)
+{
+    uint64_t ns = value.count() > 0 ? value.count() : 0;
+    ++buckets_[bucketOf(ns)];
+    ++count_;
+    if (ns > max_) {
+        max_ = ns;
+    }
+}
+
+std::chrono::nanoseconds JitterHistogram::percentile(double p) const
+{
+    if (count_ == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100 * count_ + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(std::min(upperBoundOf(i), max_));
+        }
+    }
+    return max();
+}
+
+void JitterHistogram::print(std::ostream& out, const std::string& title) const
+{
+    auto ms = [](std::chrono::nanoseconds value) { return value.count() / 1e6; };
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << title << ": " << count_ << " intervals, ms"
+        << std::fixed << std::setprecision(3)
+        << " p50=" << ms(percentile(50))
+        << " p99=" << ms(percentile(99))
+        << " p99.9=" << ms(percentile(99.9))
+        << " max=" << ms(max()) << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void FrameIntervals::tick()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (started_) {
+        histogram_.record(now - last_);
+    }
+    last_ = now;
+    started_ = true;
+}
+
+}
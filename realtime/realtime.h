@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+struct Config {
+    // mlockall of the whole process.
+    bool lockMemory = false;
+    // Cores stages are pinned to; stage N gets cpus[N], stages beyond the
+    // list are not pinned. See checkStages().
+    std::vector<int> cpus;
+    // SCHED_FIFO priority, 0 keeps the default scheduling class.
+    int fifoPriority = 0;
+
+    bool enabled() const { return lockMemory || !cpus.empty() || fifoPriority > 0; }
+};
+
+// Synopsis of the options for usage messages.
+const std::string USAGE = "[--rt] [--rt-cpus=<core>,...] [--rt-fifo=<priority>]";
+
+// Extracts real-time options from the command line, leaving other arguments
+// in place:
+//   --rt               lock memory and prefault frame buffers
+//   --rt-cpus=2,3      pin stages to the listed cores
+//   --rt-fifo=50       run stages with SCHED_FIFO at the given priority
+// Throws std::invalid_argument on malformed values; programs report it
+// together with USAGE.
+Config parseArgs(int& argc, char** argv);
+
+// Throws std::invalid_argument if more cores are listed than the program
+// has stages, instead of silently leaving some of them unused.
+void checkStages(const Config& config, size_t stages);
+
+// Process wide part of the configuration. Call once, before frame buffers
+// are allocated.
+void enterProcess(const Config& config);
+
+// Applies placement and scheduling class to the calling thread.
+// Failures (e.g. missing CAP_SYS_NICE) are reported and ignored.
+// Threads started later by the calling thread inherit both, so call it on
+// the frame loop thread once libraries have started their worker threads.
+void enterStage(const Config& config, size_t stage);
+
+// Touches every page of the buffer, so the frame loop does not take
+// page faults on first access. Use it on buffers allocated before the
+// loop and not written yet; the Config overload does it in real-time mode.
+void prefault(void* data, size_t size);
+void prefault(const Config& config, void* data, size_t size);
+
+// Log-linear histogram of durations with about 6% resolution.
+class JitterHistogram {
+public:
+    void record(std::chrono::nanoseconds value);
+
+    uint64_t count() const { return count_; }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(max_); }
+    // Upper bound of the bucket holding the given percentile (0..100).
+    std::chrono::nanoseconds percentile(double p) const;
+
+    void print(std::ostream& out, const std::string& title) const;
+
+private:
+    static constexpr size_t SUB_BUCKETS = 16;
+    static constexpr size_t BUCKETS = 64 * SUB_BUCKETS;
+
+    std::array<uint64_t, BUCKETS> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Records intervals between consecutive frames.
+class FrameIntervals {
+public:
+    void tick();
+    const JitterHistogram& histogram() const { return histogram_; }
+
+private:
+    JitterHistogram histogram_;
+    std::chrono::steady_clock::time_point last_;
+    bool started_ = false;
+};
+
+}
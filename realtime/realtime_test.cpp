@@ -0,0 +1,90 @@
+#include <gmock/gmock.h>
+
+#include "realtime/realtime.h"
+
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std::chrono_literals;
+
+TEST(JitterHistogramTest, percentilesWithinResolution)
+{
+    rt::JitterHistogram histogram;
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.record(std::chrono::microseconds(i));
+    }
+    EXPECT_EQ(1000u, histogram.count());
+    EXPECT_EQ(1000us, histogram.max());
+    EXPECT_NEAR(500e3, histogram.percentile(50).count(), 500e3 * 0.07);
+    EXPECT_NEAR(990e3, histogram.percentile(99).count(), 990e3 * 0.07);
+    EXPECT_EQ(1000us, histogram.percentile(100));
+}
+
+TEST(JitterHistogramTest, emptyHistogram)
+{
+    rt::JitterHistogram histogram;
+    EXPECT_EQ(0ns, histogram.percentile(99));
+}
+
+TEST(ParseArgsTest, extractsRealtimeOptions)
+{
+    std::vector<std::string> args = {"prog", "--rt", "cam0", "--rt-cpus=2,3", "--rt-fifo=50"};
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    int argc = args.size();
+
+    auto config = rt::parseArgs(argc, argv.data());
+    EXPECT_TRUE(config.lockMemory);
+    EXPECT_THAT(config.cpus, ::testing::ElementsAre(2, 3));
+    EXPECT_EQ(50, config.fifoPriority);
+    ASSERT_EQ(2, argc);
+    EXPECT_STREQ("cam0", argv[1]);
+}
+
+TEST(ParseArgsTest, rejectsMalformedValues)
+{
+    for (std::string bad : {"--rt-cpus=2,x", "--rt-cpus=", "--rt-cpus=-1", "--rt-fifo=abc", "--rt-fifo=50x"}) {
+        std::vector<std::string> args = {"prog", bad};
+        std::vector<char*> argv = {&args[0][0], &args[1][0], nullptr};
+        int argc = args.size();
+        EXPECT_THROW(rt::parseArgs(argc, argv.data()), std::invalid_argument) << bad;
+    }
+}
+
+TEST(ParseArgsTest, rejectsMoreCoresThanStages)
+{
+    rt::Config config;
+    config.cpus = {2, 3};
+    EXPECT_NO_THROW(rt::checkStages(config, 2));
+    EXPECT_THROW(rt::checkStages(config, 1), std::invalid_argument);
+}
+
+TEST(EnterStageTest, leavesStagesBeyondCoreListUnpinned)
+{
+    std::thread([]() {
+        cpu_set_t before;
+        pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+        rt::Config config;
+        for (int cpu = 0; config.cpus.empty(); ++cpu) {
+            if (CPU_ISSET(cpu, &before)) {
+                config.cpus.push_back(cpu);
+            }
+        }
+
+        rt::enterStage(config, 1);
+        cpu_set_t after;
+        pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+        EXPECT_TRUE(CPU_EQUAL(&before, &after));
+
+        rt::enterStage(config, 0);
+        pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+        EXPECT_EQ(1, CPU_COUNT(&after));
+        EXPECT_TRUE(CPU_ISSET(config.cpus[0], &after));
+    }).join();
+}